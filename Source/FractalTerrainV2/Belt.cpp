@@ -2,26 +2,59 @@
 
 
 #include "Belt.h"
+#include "BeltNetwork.h"
+#include "MachineSignalComponent.h"
+#include "Terrain.h"
+#include "Kismet/GameplayStatics.h"
 
 // Sets default values
-ABelt::ABelt()
+ABelt::ABelt() :
+	Length(100),
+	Speed(100),
+	NetworkIndex(INDEX_NONE),
+	m_network(nullptr),
+	m_terrain(nullptr),
+	m_terrainOccupant(-1)
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+	// Items are moved and belts signalled by the belt network
+	PrimaryActorTick.bCanEverTick = false;
 
+	Signals = CreateDefaultSubobject<UMachineSignalComponent>(TEXT("Signals"));
 }
 
 // Called when the game starts or when spawned
 void ABelt::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	m_network = ABeltNetwork::Get(GetWorld());
+	m_network->AddBelt(this);
+
+	TArray<AActor*> actors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ATerrain::StaticClass(), actors);
+	if (actors.Num() == 1) {
+		m_terrain = static_cast<ATerrain*>(actors[0]);
+		m_terrainOccupant = m_terrain->AddOccupant(this);
+	}
 }
 
-// Called every frame
-void ABelt::Tick(float DeltaTime)
+void ABelt::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	Super::Tick(DeltaTime);
+	if (m_network && !m_network->IsPendingKill())
+		m_network->RemoveBelt(this);
+	m_network = nullptr;
+
+	if (m_terrain && !m_terrain->IsPendingKill() && m_terrainOccupant >= 0)
+		m_terrain->RemoveOccupant(m_terrainOccupant);
+	m_terrainOccupant = -1;
 
+	Super::EndPlay(EndPlayReason);
 }
 
+bool ABelt::InsertItem(int32 type) {
+	return m_network && type >= 0 && type <= MAX_uint8 && m_network->InsertItem(this, static_cast<uint8>(type));
+}
+
+int32 ABelt::TakeItem() {
+	return m_network ? m_network->TakeItem(this) : -1;
+}
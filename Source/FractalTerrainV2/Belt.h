@@ -6,12 +6,22 @@
 #include "GameFramework/Actor.h"
 #include "Belt.generated.h"
 
+class ABeltNetwork;
+class ATerrain;
+class UMachineSignalComponent;
+
+/**
+	Belt segment, along the actor forward vector and centered on it.
+	Items are moved by the belt network, the belt itself does not tick.
+	The network signals it when an item reaches its end or its start has
+	room again.
+ */
 UCLASS()
 class FRACTALTERRAINV2_API ABelt : public AActor
 {
 	GENERATED_BODY()
-	
-public:	
+
+public:
 	// Sets default values for this actor's properties
 	ABelt();
 
@@ -19,8 +29,47 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-public:	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+	FVector GetStart() const {
+		return GetActorLocation() - GetActorForwardVector() * (Length / 2);
+	}
+
+	FVector GetEnd() const {
+		return GetActorLocation() + GetActorForwardVector() * (Length / 2);
+	}
+
+	/*
+		Puts an item at the start of the belt, fails if there is no room.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Belt")
+	bool InsertItem(int32 type);
+
+	/*
+		Takes the item at the end of the belt, returns its type or -1.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Belt")
+	int32 TakeItem();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	float Length;
+
+	// Item speed, in units per second
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	float Speed;
+
+	// Signals arms when an item reaches the end or the start frees up
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Belt")
+	UMachineSignalComponent* Signals;
+
+	// Index in the belt network
+	int32 NetworkIndex;
+
+private:
+	ABeltNetwork* m_network;
 
+	// Cells held in the terrain occupancy
+	ATerrain* m_terrain;
+	int32 m_terrainOccupant;
 };
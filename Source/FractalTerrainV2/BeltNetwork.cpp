@@ -0,0 +1,400 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BeltNetwork.h"
+#include "Belt.h"
+#include "FactorySubsystem.h"
+#include "MachineSignalComponent.h"
+
+#include "Algo/BinarySearch.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+ABeltNetwork::ABeltNetwork() :
+	ItemSpacing(25),
+	ItemHeight(10),
+	ConnectionTolerance(10),
+	m_laneGeneration(0),
+	m_lanesDirty(false),
+	m_factory(nullptr)
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+ABeltNetwork* ABeltNetwork::Get(UWorld* world) {
+	for (TActorIterator<ABeltNetwork> it(world); it; ++it)
+		return *it;
+
+	UE_LOG(LogTemp, Warning, TEXT("No belt network in level, items on belts will not be drawn."));
+	return world->SpawnActor<ABeltNetwork>();
+}
+
+void ABeltNetwork::BeginPlay()
+{
+	Super::BeginPlay();
+
+	m_itemInstances.SetNumZeroed(ItemMeshes.Num());
+	for (int32 type = 0; type < ItemMeshes.Num(); ++type) {
+		if (!ItemMeshes[type])
+			continue;
+
+		UInstancedStaticMeshComponent* instances = NewObject<UInstancedStaticMeshComponent>(this);
+		instances->SetStaticMesh(ItemMeshes[type]);
+		instances->SetMobility(EComponentMobility::Movable);
+		instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		instances->SetupAttachment(RootComponent);
+		instances->RegisterComponent();
+		m_itemInstances[type] = instances;
+	}
+	m_itemTransforms.SetNum(ItemMeshes.Num());
+
+	factory()->SetBeltNetwork(this);
+}
+
+void ABeltNetwork::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	factory()->Access([](FFactorySimulation& simulation) {
+		simulation.ResetLanes();
+	});
+	factory()->SetBeltNetwork(nullptr);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+UFactorySubsystem* ABeltNetwork::factory() {
+	// Belts may register before the network begins play
+	if (!m_factory)
+		m_factory = GetGameInstance()->GetSubsystem<UFactorySubsystem>();
+	return m_factory;
+}
+
+void ABeltNetwork::AddBelt(ABelt* belt) {
+	detachItems();
+
+	belt->NetworkIndex = m_belts.Add(belt);
+	m_beltLane.Add(INDEX_NONE);
+	m_beltEndDistance.Add(0);
+	m_beltSignals.Add(0);
+}
+
+void ABeltNetwork::RemoveBelt(ABelt* belt) {
+	const int32 index = belt->NetworkIndex;
+	if (!m_belts.IsValidIndex(index) || m_belts[index] != belt)
+		return;
+
+	detachItems();
+
+	// Items of the belt are lost, the last belt takes its index
+	const int32 last = m_belts.Num() - 1;
+	for (int32 i = m_looseItems.Num() - 1; i >= 0; --i) {
+		if (m_looseItems[i].belt == index)
+			m_looseItems.RemoveAtSwap(i);
+		else if (m_looseItems[i].belt == last)
+			m_looseItems[i].belt = index;
+	}
+
+	m_belts.RemoveAtSwap(index);
+	m_beltLane.RemoveAtSwap(index);
+	m_beltEndDistance.RemoveAtSwap(index);
+	m_beltSignals.RemoveAtSwap(index);
+	if (index < m_belts.Num())
+		m_belts[index]->NetworkIndex = index;
+	belt->NetworkIndex = INDEX_NONE;
+}
+
+FIntVector ABeltNetwork::connectionKey(const FVector& location) const {
+	return FIntVector(
+		FMath::RoundToInt(location.X / ConnectionTolerance),
+		FMath::RoundToInt(location.Y / ConnectionTolerance),
+		FMath::RoundToInt(location.Z / ConnectionTolerance));
+}
+
+void ABeltNetwork::detachItems() {
+	if (m_lanesDirty)
+		return;
+
+	factory()->Access([this](FFactorySimulation& simulation) {
+		for (int32 l = 0; l < m_lanes.Num(); ++l) {
+			const Lane& lane = m_lanes[l];
+			const TArray<float>& offsets = simulation.GetLaneOffsets(l);
+			const TArray<uint8>& types = simulation.GetLaneTypes(l);
+
+			// Items are sorted from the lane end, so are belts walked backwards
+			int32 k = lane.belts.Num() - 1;
+			for (int32 i = 0; i < offsets.Num(); ++i) {
+				while (k > 0 && offsets[i] >= m_beltEndDistance[lane.belts[k]] + m_belts[lane.belts[k]]->Length)
+					--k;
+				const int32 belt = lane.belts[k];
+				m_looseItems.Add({ belt, offsets[i] - m_beltEndDistance[belt], types[i] });
+			}
+		}
+		simulation.ResetLanes();
+	});
+
+	m_lanes.Reset();
+	m_lanesDirty = true;
+}
+
+void ABeltNetwork::rebuildLanes() {
+	const int32 beltCount = m_belts.Num();
+
+	TMap<FIntVector, int32> starts;
+	starts.Reserve(beltCount);
+	for (int32 b = 0; b < beltCount; ++b)
+		starts.Add(connectionKey(m_belts[b]->GetStart()), b);
+
+	// A belt feeds the one starting at its end, the first feeding it wins
+	TArray<int32> next;
+	TArray<bool> fed;
+	next.Init(INDEX_NONE, beltCount);
+	fed.Init(false, beltCount);
+	for (int32 b = 0; b < beltCount; ++b) {
+		const int32* following = starts.Find(connectionKey(m_belts[b]->GetEnd()));
+		if (following && *following != b && !fed[*following]) {
+			next[b] = *following;
+			fed[*following] = true;
+		}
+	}
+
+	m_lanes.Reset();
+	auto buildLane = [&](int32 head) {
+		const int32 laneIndex = m_lanes.AddDefaulted();
+		Lane& lane = m_lanes[laneIndex];
+		lane.length = 0;
+		lane.speed = MAX_flt;
+
+		// Loops are cut where the walk started
+		for (int32 b = head; b != INDEX_NONE && m_beltLane[b] == INDEX_NONE; b = next[b]) {
+			m_beltLane[b] = laneIndex;
+			lane.belts.Add(b);
+			lane.length += m_belts[b]->Length;
+			lane.speed = FMath::Min(lane.speed, m_belts[b]->Speed);
+		}
+
+		float endDistance = 0;
+		for (int32 k = lane.belts.Num() - 1; k >= 0; --k) {
+			m_beltEndDistance[lane.belts[k]] = endDistance;
+			endDistance += m_belts[lane.belts[k]]->Length;
+		}
+	};
+
+	for (int32 b = 0; b < beltCount; ++b)
+		m_beltLane[b] = INDEX_NONE;
+	for (int32 b = 0; b < beltCount; ++b)
+		if (!fed[b])
+			buildLane(b);
+	for (int32 b = 0; b < beltCount; ++b)
+		if (m_beltLane[b] == INDEX_NONE)
+			buildLane(b);
+
+	// Put items back on their belts
+	TArray<TArray<TPair<float, uint8>>> items;
+	items.SetNum(m_lanes.Num());
+	for (const LooseItem& item : m_looseItems) {
+		const float offset = FMath::Max(0.f, m_beltEndDistance[item.belt] + item.offset);
+		items[m_beltLane[item.belt]].Emplace(offset, item.type);
+	}
+	m_looseItems.Reset();
+
+	factory()->Access([this, &items](FFactorySimulation& simulation) {
+		simulation.ResetLanes();
+		for (int32 l = 0; l < m_lanes.Num(); ++l) {
+			items[l].Sort([](const TPair<float, uint8>& a, const TPair<float, uint8>& b) {
+				return a.Key < b.Key;
+			});
+			TArray<float> offsets;
+			TArray<uint8> types;
+			offsets.Reserve(items[l].Num());
+			types.Reserve(items[l].Num());
+			for (const TPair<float, uint8>& item : items[l]) {
+				offsets.Add(item.Key);
+				types.Add(item.Value);
+			}
+
+			simulation.AddLane(m_lanes[l].length, m_lanes[l].speed, ItemSpacing);
+			simulation.SetLaneItems(l, MoveTemp(offsets), MoveTemp(types));
+		}
+		m_laneGeneration = simulation.GetLaneGeneration();
+
+		// Before the worker steps arms with lanes of the old layout
+		m_lanesDirty = false;
+		factory()->RelinkArms();
+	});
+}
+
+bool ABeltNetwork::InsertItem(ABelt* belt, uint8 type) {
+	if (m_lanesDirty)
+		rebuildLanes();
+
+	const int32 index = belt->NetworkIndex;
+	if (!m_belts.IsValidIndex(index))
+		return false;
+
+	return factory()->Access([&](FFactorySimulation& simulation) {
+		return simulation.InsertItem(m_beltLane[index], m_beltEndDistance[index] + belt->Length, type);
+	});
+}
+
+int32 ABeltNetwork::TakeItem(ABelt* belt) {
+	if (m_lanesDirty)
+		rebuildLanes();
+
+	const int32 index = belt->NetworkIndex;
+	if (!m_belts.IsValidIndex(index))
+		return -1;
+
+	return factory()->Access([&](FFactorySimulation& simulation) {
+		return simulation.TakeItem(m_beltLane[index], m_beltEndDistance[index]);
+	});
+}
+
+int32 ABeltNetwork::PeekItem(ABelt* belt) {
+	const int32 index = belt->NetworkIndex;
+	if (m_lanesDirty || !m_belts.IsValidIndex(index))
+		return -1;
+
+	return factory()->Access([&](FFactorySimulation& simulation) {
+		const int32 lane = m_beltLane[index];
+		const int32 i = simulation.FindItem(lane, m_beltEndDistance[index]);
+		return i == INDEX_NONE ? -1 : static_cast<int32>(simulation.GetLaneTypes(lane)[i]);
+	});
+}
+
+int32 ABeltNetwork::GetItemCount() {
+	return m_looseItems.Num() + factory()->Access([](FFactorySimulation& simulation) {
+		return simulation.GetItemCount();
+	});
+}
+
+bool ABeltNetwork::GetBeltLane(const ABelt* belt, int32& lane, float& endDistance) const {
+	const int32 index = belt->NetworkIndex;
+	if (m_lanesDirty || !m_belts.IsValidIndex(index) || m_belts[index] != belt)
+		return false;
+
+	lane = m_beltLane[index];
+	endDistance = m_beltEndDistance[index];
+	return true;
+}
+
+void ABeltNetwork::HandleLaneEvent(const FFactoryEvent& event) {
+	// Event of lanes since rebuilt
+	if (m_lanesDirty || !m_lanes.IsValidIndex(event.id))
+		return;
+
+	const Lane& lane = m_lanes[event.id];
+	if (event.type == EFactoryEvent::ItemAvailable)
+		m_belts[lane.belts.Last()]->Signals->SignalItemAvailable();
+	else if (event.type == EFactoryEvent::SlotFree)
+		m_belts[lane.belts[0]]->Signals->SignalSlotFree();
+}
+
+void ABeltNetwork::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (m_lanesDirty)
+		rebuildLanes();
+
+	updateInstances();
+	signalBelts();
+}
+
+void ABeltNetwork::signalBelts() {
+	TArray<int32> available;
+	TArray<int32> free;
+	factory()->ReadSnapshots([&](const FFactorySnapshot& previous, const FFactorySnapshot& current, float alpha) {
+		if (m_lanesDirty || current.laneGeneration != m_laneGeneration || current.laneFirst.Num() != m_lanes.Num())
+			return;
+
+		for (int32 l = 0; l < m_lanes.Num(); ++l) {
+			const TArrayView<const float> offsets(current.offsets.GetData() + current.laneFirst[l], current.laneCount[l]);
+			for (int32 b : m_lanes[l].belts) {
+				// Same tests as FindItem at the belt end and InsertItem at its start
+				const float end = m_beltEndDistance[b];
+				const int32 i = Algo::LowerBound(offsets, end);
+				const bool itemAtEnd = i < offsets.Num() && offsets[i] < end + ItemSpacing / 2;
+				const float start = end + m_belts[b]->Length;
+				const int32 j = Algo::UpperBound(offsets, start - ItemSpacing);
+				const bool startFree = j == offsets.Num() || offsets[j] >= start + ItemSpacing;
+
+				const uint8 signals = (itemAtEnd ? ItemAtEnd : 0) | (startFree ? StartFree : 0);
+				if (signals & ~m_beltSignals[b] & ItemAtEnd)
+					available.Add(b);
+				if (signals & ~m_beltSignals[b] & StartFree)
+					free.Add(b);
+				m_beltSignals[b] = signals;
+			}
+		}
+	});
+
+	// Outside the snapshot lock, waiting arms access the simulation
+	for (int32 b : available)
+		m_belts[b]->Signals->SignalItemAvailable();
+	for (int32 b : free)
+		m_belts[b]->Signals->SignalSlotFree();
+}
+
+void ABeltNetwork::updateInstances() {
+	bool updated = false;
+	factory()->ReadSnapshots([&](const FFactorySnapshot& previous, const FFactorySnapshot& current, float alpha) {
+		// Lanes changed since the last step, keep items where they were drawn
+		if (current.laneGeneration != m_laneGeneration || current.laneFirst.Num() != m_lanes.Num())
+			return;
+		const bool sameLanes = previous.laneGeneration == current.laneGeneration;
+
+		for (TArray<FTransform>& transforms : m_itemTransforms)
+			transforms.Reset();
+
+		for (int32 l = 0; l < m_lanes.Num(); ++l) {
+			const Lane& lane = m_lanes[l];
+			const int32 first = current.laneFirst[l];
+			const int32 count = current.laneCount[l];
+			// Items only match if none was added or removed
+			const int32 previousFirst = sameLanes && previous.laneCount[l] == count ? previous.laneFirst[l] : INDEX_NONE;
+
+			int32 k = lane.belts.Num() - 1;
+			for (int32 i = 0; i < count; ++i) {
+				const uint8 type = current.types[first + i];
+				const float offset = previousFirst == INDEX_NONE
+					? current.offsets[first + i]
+					: FMath::Lerp(previous.offsets[previousFirst + i], current.offsets[first + i], alpha);
+				if (type >= m_itemTransforms.Num())
+					continue;
+
+				while (k > 0 && offset >= m_beltEndDistance[lane.belts[k]] + m_belts[lane.belts[k]]->Length)
+					--k;
+				const ABelt* belt = m_belts[lane.belts[k]];
+				const FVector forward = belt->GetActorForwardVector();
+				const FVector location = belt->GetEnd()
+					- forward * (offset - m_beltEndDistance[lane.belts[k]])
+					+ FVector(0, 0, ItemHeight);
+				m_itemTransforms[type].Emplace(belt->GetActorQuat(), location);
+			}
+		}
+		updated = true;
+	});
+
+	if (!updated)
+		return;
+
+	for (int32 type = 0; type < m_itemInstances.Num(); ++type) {
+		UInstancedStaticMeshComponent* instances = m_itemInstances[type];
+		if (!instances)
+			continue;
+
+		// Instances are kept up to the most items seen, the unused ones are
+		// scaled down to nothing instead of rebuilding the whole buffer
+		TArray<FTransform>& transforms = m_itemTransforms[type];
+		while (instances->GetInstanceCount() < transforms.Num())
+			instances->AddInstance(FTransform::Identity);
+		const FTransform hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+		while (transforms.Num() < instances->GetInstanceCount())
+			transforms.Add(hidden);
+		if (transforms.Num() > 0)
+			instances->BatchUpdateInstancesTransforms(0, transforms, true, true, true);
+	}
+}
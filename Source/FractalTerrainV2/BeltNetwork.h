@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "FactorySimulation.h"
+#include "BeltNetwork.generated.h"
+
+class ABelt;
+class UFactorySubsystem;
+class UInstancedStaticMeshComponent;
+class UStaticMesh;
+
+/**
+	Belts of the world. Belts whose end meets the start of another are
+	chained into lanes, which the factory simulation moves items along.
+	Items are not actors, they are drawn as instances, one instanced mesh
+	per item type, between the two last simulation steps.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API ABeltNetwork : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ABeltNetwork();
+
+	/*
+		Network of the world, spawned if the level has none.
+	*/
+	static ABeltNetwork* Get(UWorld* world);
+
+	void AddBelt(ABelt* belt);
+	void RemoveBelt(ABelt* belt);
+
+	/*
+		Puts an item at the start of belt. Fails if there is no room.
+	*/
+	bool InsertItem(ABelt* belt, uint8 type);
+
+	/*
+		Takes the item waiting at the end of belt. Returns its type, -1 if
+		there is none.
+	*/
+	int32 TakeItem(ABelt* belt);
+
+	// Type of the item waiting at the end of belt, -1 if there is none
+	int32 PeekItem(ABelt* belt);
+
+	int32 GetItemCount();
+
+	/*
+		Lane of belt and distance from the belt end to the lane end. Fails
+		while lanes are being rebuilt.
+	*/
+	bool GetBeltLane(const ABelt* belt, int32& lane, float& endDistance) const;
+
+	// Lane events of the factory simulation
+	void HandleLaneEvent(const FFactoryEvent& event);
+
+	virtual void Tick(float DeltaTime) override;
+
+	// Item meshes by item type, ores use their block type (2 dirt, 3 coal)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	TArray<UStaticMesh*> ItemMeshes;
+
+	// Minimum distance between two items of a lane
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	float ItemSpacing;
+
+	// Height of items above the belt origin
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	float ItemHeight;
+
+	// Belt ends closer than this are connected
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Belt")
+	float ConnectionTolerance;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Lane i is lane i of the simulation
+	struct Lane {
+		// Belt indices, start to end
+		TArray<int32> belts;
+		float length;
+		float speed;
+	};
+
+	// Item whose lane is being rebuilt, offset is to the end of its belt
+	struct LooseItem {
+		int32 belt;
+		float offset;
+		uint8 type;
+	};
+
+	// Moves every item to m_looseItems, before belts change
+	void detachItems();
+	void rebuildLanes();
+
+	void updateInstances();
+
+	/*
+		Signals belts an item reached the end of, or whose start has room
+		again, so arms waiting on them need not poll.
+	*/
+	void signalBelts();
+
+	FIntVector connectionKey(const FVector& location) const;
+
+	UFactorySubsystem* factory();
+
+	UPROPERTY()
+	TArray<ABelt*> m_belts;
+
+	enum BeltSignal : uint8 {
+		ItemAtEnd = 1,
+		StartFree = 2
+	};
+
+	// Per belt
+	TArray<int32> m_beltLane;
+	TArray<float> m_beltEndDistance;
+	// BeltSignal flags of the last check
+	TArray<uint8> m_beltSignals;
+
+	TArray<Lane> m_lanes;
+	// Simulation lanes generation m_lanes matches
+	uint32 m_laneGeneration;
+	TArray<LooseItem> m_looseItems;
+	bool m_lanesDirty;
+
+	UFactorySubsystem* m_factory;
+
+	UPROPERTY()
+	TArray<UInstancedStaticMeshComponent*> m_itemInstances;
+	// Per item type, reused every frame
+	TArray<TArray<FTransform>> m_itemTransforms;
+};
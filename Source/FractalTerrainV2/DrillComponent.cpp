@@ -0,0 +1,121 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DrillComponent.h"
+#include "MachineInventoryComponent.h"
+#include "Terrain.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Drill extraction"), STAT_DrillExtraction, STATGROUP_Game);
+
+UDrillComponent::UDrillComponent() :
+	Radius(1),
+	Depth(16),
+	ExtractionInterval(1),
+	LayersPerExtraction(1),
+	m_terrain(nullptr),
+	m_inventory(nullptr),
+	m_terrainOccupant(-1),
+	m_layer(0)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UDrillComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TArray<AActor*> actors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ATerrain::StaticClass(), actors);
+	m_inventory = UMachineInventoryComponent::Find(GetOwner());
+	if (actors.Num() != 1 || !m_inventory) {
+		UE_LOG(LogTemp, Warning, TEXT("Drill %s needs a terrain and an inventory, it will not mine."), *GetNameSafe(GetOwner()));
+		SetComponentTickEnabled(false);
+		return;
+	}
+	m_terrain = static_cast<ATerrain*>(actors[0]);
+	m_terrainOccupant = m_terrain->AddOccupant(GetOwner());
+
+	// Footprint starts at the block under the owner
+	const FVector location = GetOwner()->GetActorLocation() / m_terrain->VoxelSize;
+	m_top = FIntVector(
+		FMath::FloorToInt(location.X),
+		FMath::FloorToInt(location.Y),
+		FMath::FloorToInt(location.Z) - 1);
+	m_layer = 0;
+
+	// Whole yield up front, extractions then only subtract what they carve
+	Yield.Reset();
+	if (Depth > 0)
+		Yield = m_terrain->CountMaterials(
+			m_top - FIntVector(Radius, Radius, Depth - 1),
+			m_top + FIntVector(Radius, Radius, 0));
+	m_pending.Reset();
+
+	SetComponentTickInterval(ExtractionInterval);
+	SetComponentTickEnabled(!IsExhausted());
+}
+
+void UDrillComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (m_terrain && !m_terrain->IsPendingKill() && m_terrainOccupant >= 0)
+		m_terrain->RemoveOccupant(m_terrainOccupant);
+	m_terrainOccupant = -1;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+int32 UDrillComponent::GetRemaining(int32 type) const {
+	const int32* count = Yield.Find(type);
+	return count ? *count : 0;
+}
+
+bool UDrillComponent::IsExhausted() const {
+	return m_layer >= Depth || Yield.Num() == 0;
+}
+
+void UDrillComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	SCOPE_CYCLE_COUNTER(STAT_DrillExtraction);
+
+	// Stalls while the inventory is full
+	if (!deliver())
+		return;
+	if (IsExhausted()) {
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Layers of the extraction in a single edit, the terrain remeshes the
+	// chunks it touched once on its next tick
+	const int32 last = FMath::Min(m_layer + FMath::Max(LayersPerExtraction, 1), Depth) - 1;
+	m_pending = m_terrain->CarveBox(
+		m_top - FIntVector(Radius, Radius, last),
+		m_top + FIntVector(Radius, Radius, -m_layer));
+	m_layer = last + 1;
+
+	// Blocks may also have been removed by someone else, the yield is an
+	// estimate kept without rescanning
+	for (const TPair<int32, int32>& carved : m_pending) {
+		int32* count = Yield.Find(carved.Key);
+		if (count && (*count -= carved.Value) <= 0)
+			Yield.Remove(carved.Key);
+	}
+	if (m_layer >= Depth)
+		Yield.Reset();
+
+	deliver();
+}
+
+bool UDrillComponent::deliver() {
+	for (auto it = m_pending.CreateIterator(); it; ++it) {
+		while (it.Value() > 0 && m_inventory->AddItem(it.Key()))
+			--it.Value();
+		if (it.Value() > 0)
+			return false;
+		it.RemoveCurrent();
+	}
+	return true;
+}
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "DrillComponent.generated.h"
+
+class ATerrain;
+class UMachineInventoryComponent;
+
+/**
+	Mines the terrain under a drill (Foreuse). The ore yield of the whole
+	footprint is counted once when placed, then the drill carves one layer
+	per extraction, top down, and moves what it carved to the inventory of
+	its owner. Each extraction is a single region edit, so its cost does
+	not depend on how much has been mined.
+ */
+UCLASS(ClassGroup = (Factory), meta = (BlueprintSpawnableComponent))
+class FRACTALTERRAINV2_API UDrillComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UDrillComponent();
+
+	/*
+		Number of blocks of type left in the footprint, as far as the drill
+		knows.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Drill")
+	int32 GetRemaining(int32 type) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Drill")
+	bool IsExhausted() const;
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Footprint is (2 * Radius + 1) blocks wide, centered under the owner
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drill")
+	int32 Radius;
+
+	// Blocks mined below the owner
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drill")
+	int32 Depth;
+
+	// Seconds between two extractions
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drill")
+	float ExtractionInterval;
+
+	// Layers carved by an extraction
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Drill")
+	int32 LayersPerExtraction;
+
+	// Blocks left in the footprint, block type -> count
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Drill")
+	TMap<int32, int32> Yield;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	// Hands carved items to the inventory, returns whether all went in
+	bool deliver();
+
+	UPROPERTY()
+	ATerrain* m_terrain;
+	UPROPERTY()
+	UMachineInventoryComponent* m_inventory;
+	// Cells of the owner in the terrain occupancy
+	int32 m_terrainOccupant;
+
+	// Top layer of the footprint and next layer to carve
+	FIntVector m_top;
+	int32 m_layer;
+	// Carved items the inventory had no room for yet, block type -> count
+	TMap<int32, int32> m_pending;
+};
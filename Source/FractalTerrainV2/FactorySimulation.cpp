@@ -0,0 +1,352 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FactorySimulation.h"
+
+#include "Algo/BinarySearch.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+constexpr float FFactorySimulation::StepSeconds;
+constexpr float FFactorySimulation::ArmPickTime;
+constexpr float FFactorySimulation::ArmTryDropTime;
+constexpr float FFactorySimulation::ArmDropTime;
+
+static FAutoConsoleCommand FactoryBenchmarkCommand(
+	TEXT("Factory.Benchmark"),
+	TEXT("Simulates a synthetic factory without rendering and reports simulated ticks per second. Optional arguments: lanes (default 1000), items per lane (default 20), arms (default 1000), minutes (default 10)."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+		const int32 lanes = FMath::Max(args.Num() > 0 ? FCString::Atoi(*args[0]) : 1000, 1);
+		const int32 items = args.Num() > 1 ? FCString::Atoi(*args[1]) : 20;
+		const int32 arms = args.Num() > 2 ? FCString::Atoi(*args[2]) : 1000;
+		const float minutes = args.Num() > 3 ? FCString::Atof(*args[3]) : 10;
+
+		// Arms move items from each lane to the next one
+		FFactorySimulation simulation;
+		FRandomStream random(42);
+		for (int32 l = 0; l < lanes; ++l) {
+			const int32 lane = simulation.AddLane(1000, 100, 25);
+			for (int32 i = 0; i < items; ++i)
+				simulation.InsertItem(lane, random.FRandRange(0, 1000), static_cast<uint8>(random.RandRange(2, 3)));
+		}
+		for (int32 a = 0; a < arms; ++a) {
+			const int32 arm = simulation.AddArm(random.FRandRange(0.2f, 0.5f));
+			simulation.LinkArm(arm, a % lanes, 0, (a + 1) % lanes, 1000);
+		}
+
+		const uint64 startTick = simulation.GetTick();
+		const double start = FPlatformTime::Seconds();
+		simulation.FastForward(minutes * 60);
+		const double seconds = FPlatformTime::Seconds() - start;
+		const uint64 ticks = simulation.GetTick() - startTick;
+
+		UE_LOG(LogTemp, Display, TEXT("Factory %d lanes, %d items, %d arms: %llu ticks in %.3f s, %.0f ticks/s, %.0fx real time"),
+			lanes, simulation.GetItemCount(), arms, ticks, seconds,
+			ticks / seconds, ticks * FFactorySimulation::StepSeconds / seconds);
+	}));
+
+FFactorySimulation::FFactorySimulation() :
+	m_laneGeneration(0),
+	m_tick(0),
+	m_fastForward(false)
+{
+}
+
+void FFactorySimulation::ResetLanes() {
+	m_lanes.Reset();
+	++m_laneGeneration;
+}
+
+int32 FFactorySimulation::AddLane(float length, float speed, float spacing) {
+	const int32 index = m_lanes.AddDefaulted();
+	Lane& lane = m_lanes[index];
+	lane.length = length;
+	lane.speed = speed;
+	lane.spacing = spacing;
+	lane.frontArrived = false;
+	lane.startBlocked = false;
+	return index;
+}
+
+void FFactorySimulation::SetLaneItems(int32 lane, TArray<float>&& offsets, TArray<uint8>&& types) {
+	Lane& target = m_lanes[lane];
+	target.offsets = MoveTemp(offsets);
+	target.types = MoveTemp(types);
+	target.frontArrived = target.offsets.Num() > 0 && target.offsets[0] <= 0;
+}
+
+bool FFactorySimulation::InsertItem(int32 lane, float offset, uint8 type) {
+	Lane& target = m_lanes[lane];
+
+	// First item that could be too close, others are sorted away from it
+	const int32 i = Algo::UpperBound(target.offsets, offset - target.spacing);
+	if (i < target.offsets.Num() && target.offsets[i] < offset + target.spacing) {
+		if (offset >= target.length)
+			target.startBlocked = true;
+		return false;
+	}
+
+	target.offsets.Insert(offset, i);
+	target.types.Insert(type, i);
+	return true;
+}
+
+int32 FFactorySimulation::FindItem(int32 lane, float endDistance) const {
+	const Lane& source = m_lanes[lane];
+	const int32 i = Algo::LowerBound(source.offsets, endDistance);
+	if (i < source.offsets.Num() && source.offsets[i] < endDistance + source.spacing / 2)
+		return i;
+	return INDEX_NONE;
+}
+
+int32 FFactorySimulation::TakeItem(int32 lane, float endDistance) {
+	const int32 i = FindItem(lane, endDistance);
+	if (i == INDEX_NONE)
+		return -1;
+
+	Lane& source = m_lanes[lane];
+	const int32 type = source.types[i];
+	source.offsets.RemoveAt(i);
+	source.types.RemoveAt(i);
+	source.frontArrived = source.offsets.Num() > 0 && source.offsets[0] <= 0;
+	return type;
+}
+
+int32 FFactorySimulation::AddArm(float rate) {
+	int32 arm;
+	if (m_freeArms.Num() > 0)
+		arm = m_freeArms.Pop();
+	else {
+		arm = m_armTime.Num();
+		m_armTime.AddZeroed();
+		m_armRate.AddZeroed();
+		m_armState.Add(ArmState::Free);
+		m_armNotified.Add(false);
+		m_armSource.Add(INDEX_NONE);
+		m_armSourceOffset.AddZeroed();
+		m_armDestination.Add(INDEX_NONE);
+		m_armDestinationOffset.AddZeroed();
+		m_armSourceLink.AddDefaulted();
+		m_armDestinationLink.AddDefaulted();
+		m_armHeld.Add(-1);
+	}
+
+	m_armTime[arm] = 0;
+	m_armRate[arm] = rate;
+	m_armState[arm] = ArmState::WaitPick;
+	m_armNotified[arm] = false;
+	m_armSource[arm] = INDEX_NONE;
+	m_armDestination[arm] = INDEX_NONE;
+	m_armHeld[arm] = -1;
+	return arm;
+}
+
+int32 FFactorySimulation::RemoveArm(int32 arm) {
+	if (!m_armState.IsValidIndex(arm) || m_armState[arm] == ArmState::Free)
+		return -1;
+
+	const int32 held = m_armHeld[arm];
+	m_armHeld[arm] = -1;
+	m_armState[arm] = ArmState::Free;
+	m_armSourceLink[arm].Reset();
+	m_armDestinationLink[arm].Reset();
+	m_freeArms.Add(arm);
+	return held;
+}
+
+void FFactorySimulation::LinkArm(int32 arm, int32 sourceLane, float sourceOffset, int32 destinationLane, float destinationOffset) {
+	m_armSource[arm] = sourceLane;
+	m_armSourceOffset[arm] = sourceOffset;
+	m_armDestination[arm] = destinationLane;
+	m_armDestinationOffset[arm] = destinationOffset;
+}
+
+void FFactorySimulation::SetArmMachineLinks(int32 arm, const FMachineLinkPtr& source, const FMachineLinkPtr& destination) {
+	m_armSourceLink[arm] = source;
+	m_armDestinationLink[arm] = destination;
+}
+
+void FFactorySimulation::ResumeArm(int32 arm, int32 itemType) {
+	if (m_armState[arm] == ArmState::WaitPick)
+		m_armHeld[arm] = itemType >= 0 && itemType <= MAX_uint8 ? static_cast<int16>(itemType) : -1;
+	else if (m_armState[arm] == ArmState::WaitDrop)
+		m_armHeld[arm] = -1;
+	else
+		return;
+
+	m_armState[arm] = ArmState::Moving;
+	m_armNotified[arm] = false;
+}
+
+void FFactorySimulation::Step() {
+	stepLanes();
+	stepArms();
+	++m_tick;
+}
+
+void FFactorySimulation::FastForward(float seconds) {
+	m_fastForward = true;
+	const int64 steps = FMath::FloorToInt(seconds / StepSeconds);
+	for (int64 i = 0; i < steps; ++i)
+		Step();
+	m_fastForward = false;
+}
+
+void FFactorySimulation::addEvent(EFactoryEvent type, int32 id) {
+	if (m_fastForward && (type == EFactoryEvent::ArmPick || type == EFactoryEvent::ArmDrop))
+		return;
+	m_events.Add({ type, id });
+}
+
+void FFactorySimulation::stepLanes() {
+	for (int32 l = 0; l < m_lanes.Num(); ++l) {
+		Lane& lane = m_lanes[l];
+		const float step = lane.speed * StepSeconds;
+
+		// Each item stops behind the one in front of it
+		float limit = 0;
+		for (float& offset : lane.offsets) {
+			offset = FMath::Min(offset, FMath::Max(offset - step, limit));
+			limit = offset + lane.spacing;
+		}
+
+		const bool arrived = lane.offsets.Num() > 0 && lane.offsets[0] <= 0;
+		if (arrived && !lane.frontArrived)
+			addEvent(EFactoryEvent::ItemAvailable, l);
+		lane.frontArrived = arrived;
+
+		if (lane.startBlocked && (lane.offsets.Num() == 0 || lane.offsets.Last() <= lane.length - lane.spacing)) {
+			lane.startBlocked = false;
+			addEvent(EFactoryEvent::SlotFree, l);
+		}
+	}
+}
+
+bool FFactorySimulation::tryPick(int32 arm) {
+	const int32 lane = m_armSource[arm];
+	if (lane == INDEX_NONE && m_armSourceLink[arm].IsValid()) {
+		uint8 type;
+		if (!m_armSourceLink[arm]->Pop(type))
+			return false;
+		m_armHeld[arm] = type;
+		return true;
+	}
+	if (lane == INDEX_NONE) {
+		if (!m_armNotified[arm]) {
+			m_armNotified[arm] = true;
+			addEvent(EFactoryEvent::ArmWaitPick, arm);
+		}
+		return false;
+	}
+	// Lanes are being rebuilt, the arm is linked again after
+	if (!m_lanes.IsValidIndex(lane))
+		return false;
+
+	const int32 type = TakeItem(lane, m_armSourceOffset[arm]);
+	if (type < 0)
+		return false;
+	m_armHeld[arm] = type;
+	return true;
+}
+
+bool FFactorySimulation::tryDrop(int32 arm) {
+	const int32 lane = m_armDestination[arm];
+	if (lane == INDEX_NONE && m_armDestinationLink[arm].IsValid()) {
+		if (m_armHeld[arm] >= 0 && !m_armDestinationLink[arm]->Push(static_cast<uint8>(m_armHeld[arm])))
+			return false;
+		m_armHeld[arm] = -1;
+		return true;
+	}
+	if (lane == INDEX_NONE) {
+		if (!m_armNotified[arm]) {
+			m_armNotified[arm] = true;
+			addEvent(EFactoryEvent::ArmWaitDrop, arm);
+		}
+		return false;
+	}
+	// Lanes are being rebuilt, the arm is linked again after
+	if (!m_lanes.IsValidIndex(lane))
+		return false;
+
+	// Nothing to drop
+	if (m_armHeld[arm] < 0)
+		return true;
+
+	if (!InsertItem(lane, m_armDestinationOffset[arm], static_cast<uint8>(m_armHeld[arm])))
+		return false;
+	m_armHeld[arm] = -1;
+	return true;
+}
+
+void FFactorySimulation::stepArms() {
+	for (int32 arm = 0; arm < m_armState.Num(); ++arm) {
+		switch (m_armState[arm]) {
+		case ArmState::WaitPick:
+			if (!tryPick(arm))
+				continue;
+			break;
+		case ArmState::WaitDrop:
+			if (!tryDrop(arm))
+				continue;
+			break;
+		case ArmState::Moving:
+			break;
+		default:
+			continue;
+		}
+		m_armState[arm] = ArmState::Moving;
+		m_armNotified[arm] = false;
+
+		// Go through every cycle position passed during the step
+		float time = m_armTime[arm];
+		float remaining = m_armRate[arm] * StepSeconds;
+		while (remaining > 0) {
+			const float next = time < ArmPickTime ? ArmPickTime
+				: time < ArmTryDropTime ? ArmTryDropTime
+				: time < ArmDropTime ? ArmDropTime
+				: 1.f;
+			if (time + remaining < next) {
+				time += remaining;
+				break;
+			}
+
+			remaining -= next - time;
+			time = next < 1.f ? next : 0.f;
+			if (next == ArmPickTime)
+				addEvent(EFactoryEvent::ArmPick, arm);
+			else if (next == ArmDropTime)
+				addEvent(EFactoryEvent::ArmDrop, arm);
+			else if (next == ArmTryDropTime && !tryDrop(arm)) {
+				m_armState[arm] = ArmState::WaitDrop;
+				break;
+			} else if (next == 1.f && !tryPick(arm)) {
+				m_armState[arm] = ArmState::WaitPick;
+				break;
+			}
+		}
+		m_armTime[arm] = time;
+	}
+}
+
+int32 FFactorySimulation::GetItemCount() const {
+	int32 count = 0;
+	for (const Lane& lane : m_lanes)
+		count += lane.offsets.Num();
+	return count;
+}
+
+void FFactorySimulation::WriteSnapshot(FFactorySnapshot& snapshot) const {
+	snapshot.tick = m_tick;
+	snapshot.laneGeneration = m_laneGeneration;
+	snapshot.laneFirst.Reset(m_lanes.Num());
+	snapshot.laneCount.Reset(m_lanes.Num());
+	snapshot.offsets.Reset();
+	snapshot.types.Reset();
+	for (const Lane& lane : m_lanes) {
+		snapshot.laneFirst.Add(snapshot.offsets.Num());
+		snapshot.laneCount.Add(lane.offsets.Num());
+		snapshot.offsets.Append(lane.offsets);
+		snapshot.types.Append(lane.types);
+	}
+	snapshot.armTimes = m_armTime;
+}
@@ -0,0 +1,201 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MachineLink.h"
+
+enum class EFactoryEvent : uint8 {
+	// Front item of a lane reached its end
+	ItemAvailable,
+	// Start of a lane has room again after an insertion failed
+	SlotFree,
+	// Arm waits on a machine outside the simulation, until resumed
+	ArmWaitPick,
+	ArmWaitDrop,
+	// Arm passed its pick or drop position
+	ArmPick,
+	ArmDrop
+};
+
+struct FFactoryEvent {
+	EFactoryEvent type;
+	// Lane or arm
+	int32 id;
+};
+
+/*
+	State of the simulation after a step, for rendering.
+*/
+struct FFactorySnapshot {
+	uint64 tick;
+	// FPlatformTime::Seconds() when the step was taken
+	double time;
+
+	// Changes each time lanes are rebuilt, lane items only match within one
+	uint32 laneGeneration;
+	// Items of lane i are [laneFirst[i], laneFirst[i] + laneCount[i])
+	TArray<int32> laneFirst;
+	TArray<int32> laneCount;
+	TArray<float> offsets;
+	TArray<uint8> types;
+
+	// Per arm slot
+	TArray<float> armTimes;
+};
+
+/**
+	Belt lanes and robot arms stepped at a fixed rate, so the factory runs
+	the same whatever the frame rate and can be simulated ahead in bulk.
+	Only plain data, not thread safe: the owner serialises access.
+
+	Lanes keep their items as distances to their end, front item first.
+	Arms loop over their path, time in [0, 1), and pick from and drop to
+	lanes or machine links on their own. Arms working with other machines
+	wait for the game to resume them.
+ */
+class FFactorySimulation {
+public:
+	static constexpr float StepSeconds = 1.f / 30;
+
+	// Positions along the arm cycle, the path has 6 nodes
+	static constexpr float ArmPickTime = 1.f / 6;
+	static constexpr float ArmTryDropTime = 3.f / 6;
+	static constexpr float ArmDropTime = 4.f / 6;
+
+	FFactorySimulation();
+
+	void ResetLanes();
+	int32 AddLane(float length, float speed, float spacing);
+	int32 GetLaneCount() const {
+		return m_lanes.Num();
+	}
+	uint32 GetLaneGeneration() const {
+		return m_laneGeneration;
+	}
+
+	// Replaces the lane items, sorted by offset
+	void SetLaneItems(int32 lane, TArray<float>&& offsets, TArray<uint8>&& types);
+	const TArray<float>& GetLaneOffsets(int32 lane) const {
+		return m_lanes[lane].offsets;
+	}
+	const TArray<uint8>& GetLaneTypes(int32 lane) const {
+		return m_lanes[lane].types;
+	}
+
+	/*
+		Puts an item offset from the lane end. Fails if it is closer than
+		the lane spacing to another item.
+	*/
+	bool InsertItem(int32 lane, float offset, uint8 type);
+
+	/*
+		Item stopped at endDistance from the lane end, within half the lane
+		spacing. Returns its index, INDEX_NONE if there is none.
+	*/
+	int32 FindItem(int32 lane, float endDistance) const;
+
+	// Takes the item found by FindItem, returns its type or -1
+	int32 TakeItem(int32 lane, float endDistance);
+
+	/*
+		Adds an arm going through its cycle rate times per second. It starts
+		waiting to pick.
+	*/
+	int32 AddArm(float rate);
+	// Returns the item type the arm held, -1 for none
+	int32 RemoveArm(int32 arm);
+
+	/*
+		Lanes the arm picks from and drops to, at given distance from the
+		lane end. INDEX_NONE for machines handled by the game.
+	*/
+	void LinkArm(int32 arm, int32 sourceLane, float sourceOffset, int32 destinationLane, float destinationOffset);
+
+	/*
+		Machine links the arm picks from and drops to when it has no lane,
+		the simulation is their consumer and producer respectively.
+	*/
+	void SetArmMachineLinks(int32 arm, const FMachineLinkPtr& source, const FMachineLinkPtr& destination);
+
+	/*
+		Ends an arm wait on a machine handled by the game. itemType is the
+		item picked, -1 if unknown: the arm then drops nothing onto lanes
+		or links. Ignored when dropping.
+	*/
+	void ResumeArm(int32 arm, int32 itemType = -1);
+
+	void Step();
+
+	/*
+		Steps over given time at once. Pick and drop events are not
+		recorded, they only animate.
+	*/
+	void FastForward(float seconds);
+
+	uint64 GetTick() const {
+		return m_tick;
+	}
+
+	// Appended by Step, emptied by the owner
+	TArray<FFactoryEvent>& GetEvents() {
+		return m_events;
+	}
+
+	int32 GetItemCount() const;
+
+	void WriteSnapshot(FFactorySnapshot& snapshot) const;
+
+private:
+	struct Lane {
+		float length;
+		float speed;
+		float spacing;
+
+		// Distance of each item to the lane end, front item first
+		TArray<float> offsets;
+		TArray<uint8> types;
+
+		bool frontArrived;
+		bool startBlocked;
+	};
+
+	enum class ArmState : uint8 {
+		Free,
+		Moving,
+		WaitPick,
+		WaitDrop
+	};
+
+	void stepLanes();
+	void stepArms();
+
+	// Returns false if the arm has to wait
+	bool tryPick(int32 arm);
+	bool tryDrop(int32 arm);
+
+	void addEvent(EFactoryEvent type, int32 id);
+
+	TArray<Lane> m_lanes;
+	uint32 m_laneGeneration;
+
+	// Per arm slot
+	TArray<float> m_armTime;
+	TArray<float> m_armRate;
+	TArray<ArmState> m_armState;
+	// Whether the game was told about the current wait
+	TArray<bool> m_armNotified;
+	TArray<int32> m_armSource;
+	TArray<float> m_armSourceOffset;
+	TArray<int32> m_armDestination;
+	TArray<float> m_armDestinationOffset;
+	TArray<FMachineLinkPtr> m_armSourceLink;
+	TArray<FMachineLinkPtr> m_armDestinationLink;
+	// Item type held, -1 for none
+	TArray<int16> m_armHeld;
+	TArray<int32> m_freeArms;
+
+	TArray<FFactoryEvent> m_events;
+	uint64 m_tick;
+	bool m_fastForward;
+};
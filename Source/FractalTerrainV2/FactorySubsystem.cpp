@@ -0,0 +1,260 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FactorySubsystem.h"
+#include "Belt.h"
+#include "BeltNetwork.h"
+#include "MachineInventoryComponent.h"
+#include "RobotArm.h"
+
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+
+/*
+	Steps the simulation on time, catching up on late steps.
+*/
+class FFactorySimulationRunnable : public FRunnable {
+public:
+	explicit FFactorySimulationRunnable(UFactorySubsystem& owner) :
+		m_owner(owner),
+		m_stop(false)
+	{}
+
+	virtual uint32 Run() override {
+		double next = FPlatformTime::Seconds();
+		while (!m_stop) {
+			const double now = FPlatformTime::Seconds();
+			if (now < next) {
+				FPlatformProcess::Sleep(static_cast<float>(next - now));
+				continue;
+			}
+
+			m_owner.step();
+			next += FFactorySimulation::StepSeconds;
+			// Too far behind (debugger, machine asleep), drop the backlog
+			if (now - next > 0.25)
+				next = now;
+		}
+		return 0;
+	}
+
+	virtual void Stop() override {
+		m_stop = true;
+	}
+
+private:
+	UFactorySubsystem& m_owner;
+	FThreadSafeBool m_stop;
+};
+
+UFactorySubsystem::UFactorySubsystem() :
+	m_runnable(nullptr),
+	m_thread(nullptr),
+	m_accumulator(0)
+{
+}
+
+void UFactorySubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+	Super::Initialize(Collection);
+
+	m_simulation.WriteSnapshot(m_previous);
+	m_simulation.WriteSnapshot(m_current);
+	m_previous.time = m_current.time = FPlatformTime::Seconds();
+
+	if (FPlatformProcess::SupportsMultithreading()) {
+		m_runnable = new FFactorySimulationRunnable(*this);
+		m_thread = FRunnableThread::Create(m_runnable, TEXT("FactorySimulation"));
+	}
+}
+
+void UFactorySubsystem::Deinitialize() {
+	if (m_thread) {
+		m_thread->Kill(true);
+		delete m_thread;
+		m_thread = nullptr;
+	}
+	delete m_runnable;
+	m_runnable = nullptr;
+
+	Super::Deinitialize();
+}
+
+void UFactorySubsystem::step() {
+	FScopeLock lock(&m_lock);
+	m_simulation.Step();
+	m_events.Append(m_simulation.GetEvents());
+	m_simulation.GetEvents().Reset();
+
+	Swap(m_previous, m_current);
+	m_simulation.WriteSnapshot(m_current);
+	m_current.time = FPlatformTime::Seconds();
+}
+
+void UFactorySubsystem::FastForward(float seconds) {
+	FScopeLock lock(&m_lock);
+	m_simulation.FastForward(seconds);
+	m_events.Append(m_simulation.GetEvents());
+	m_simulation.GetEvents().Reset();
+
+	// Nothing to interpolate from
+	m_simulation.WriteSnapshot(m_current);
+	m_current.time = FPlatformTime::Seconds();
+	m_previous = m_current;
+}
+
+void UFactorySubsystem::ReadSnapshots(TFunctionRef<void(const FFactorySnapshot& previous, const FFactorySnapshot& current, float alpha)> reader) {
+	FScopeLock lock(&m_lock);
+	const float alpha = FMath::Clamp(
+		static_cast<float>((FPlatformTime::Seconds() - m_current.time) / FFactorySimulation::StepSeconds), 0.f, 1.f);
+	reader(m_previous, m_current, alpha);
+}
+
+int32 UFactorySubsystem::AddArm(ARobotArm* arm, float rate) {
+	const int32 index = Access([rate](FFactorySimulation& simulation) {
+		return simulation.AddArm(rate);
+	});
+	if (m_arms.Num() <= index) {
+		m_arms.SetNum(index + 1);
+		m_armSourceLinks.SetNum(index + 1);
+		m_armDestinationLinks.SetNum(index + 1);
+	}
+	m_arms[index] = arm;
+	linkArm(index);
+	return index;
+}
+
+void UFactorySubsystem::RemoveArm(int32 index) {
+	const int32 held = Access([index](FFactorySimulation& simulation) {
+		return simulation.RemoveArm(index);
+	});
+	if (!m_arms.IsValidIndex(index))
+		return;
+
+	closeArmLinks(index, held);
+	m_arms[index].Reset();
+}
+
+void UFactorySubsystem::closeArmLinks(int32 index, int32 heldItem) {
+	// The simulation let go of the links, items in flight go back to the
+	// machines and the held item to where it came from
+	const ARobotArm* arm = m_arms[index].Get();
+	UMachineInventoryComponent* source = m_armSourceLinks[index].IsValid()
+		? UMachineInventoryComponent::Find(arm ? arm->Src : nullptr) : nullptr;
+	UMachineInventoryComponent* destination = m_armDestinationLinks[index].IsValid()
+		? UMachineInventoryComponent::Find(arm ? arm->Dst : nullptr) : nullptr;
+	if (source)
+		source->CloseLink(m_armSourceLinks[index]);
+	if (destination)
+		destination->CloseLink(m_armDestinationLinks[index]);
+
+	if (heldItem >= 0) {
+		UMachineInventoryComponent* inventory = source ? source : destination;
+		if (inventory && !inventory->AddItem(heldItem))
+			UE_LOG(LogTemp, Warning, TEXT("No slot left for item %d held by removed arm, lost."), heldItem);
+	}
+	m_armSourceLinks[index].Reset();
+	m_armDestinationLinks[index].Reset();
+}
+
+void UFactorySubsystem::RelinkArms() {
+	for (int32 index = 0; index < m_arms.Num(); ++index)
+		linkArm(index);
+}
+
+void UFactorySubsystem::linkArm(int32 index) {
+	const ARobotArm* arm = m_arms[index].Get();
+	if (!arm)
+		return;
+
+	// Belts are lanes of the simulation
+	int32 source = INDEX_NONE;
+	int32 destination = INDEX_NONE;
+	float sourceOffset = 0;
+	float destinationOffset = 0;
+	if (ABeltNetwork* network = m_beltNetwork.Get()) {
+		if (const ABelt* belt = Cast<ABelt>(arm->Src))
+			if (!network->GetBeltLane(belt, source, sourceOffset))
+				source = INDEX_NONE;
+		if (const ABelt* belt = Cast<ABelt>(arm->Dst)) {
+			if (network->GetBeltLane(belt, destination, destinationOffset))
+				destinationOffset += belt->Length;
+			else
+				destination = INDEX_NONE;
+		}
+	}
+
+	// Then machines with an inventory hand items through links, the game
+	// handles the others
+	UMachineInventoryComponent* sourceInventory = UMachineInventoryComponent::Find(arm->Src);
+	if (source == INDEX_NONE && sourceInventory && !m_armSourceLinks[index].IsValid())
+		m_armSourceLinks[index] = sourceInventory->OpenOutput();
+	UMachineInventoryComponent* destinationInventory = UMachineInventoryComponent::Find(arm->Dst);
+	if (destination == INDEX_NONE && destinationInventory && !m_armDestinationLinks[index].IsValid())
+		m_armDestinationLinks[index] = destinationInventory->OpenInput();
+
+	const FMachineLinkPtr sourceLink = source == INDEX_NONE ? m_armSourceLinks[index] : FMachineLinkPtr();
+	const FMachineLinkPtr destinationLink = destination == INDEX_NONE ? m_armDestinationLinks[index] : FMachineLinkPtr();
+	Access([&](FFactorySimulation& simulation) {
+		simulation.LinkArm(index, source, sourceOffset, destination, destinationOffset);
+		simulation.SetArmMachineLinks(index, sourceLink, destinationLink);
+	});
+}
+
+void UFactorySubsystem::Tick(float DeltaTime) {
+	if (!m_thread) {
+		m_accumulator += DeltaTime;
+		while (m_accumulator >= FFactorySimulation::StepSeconds) {
+			step();
+			m_accumulator -= FFactorySimulation::StepSeconds;
+		}
+	}
+
+	TArray<FFactoryEvent> events;
+	{
+		FScopeLock lock(&m_lock);
+		events = MoveTemp(m_events);
+		m_events.Reset();
+	}
+
+	// Handlers may edit the simulation, so the lock is released
+	for (const FFactoryEvent& event : events) {
+		switch (event.type) {
+		case EFactoryEvent::ItemAvailable:
+		case EFactoryEvent::SlotFree:
+			if (ABeltNetwork* network = m_beltNetwork.Get())
+				network->HandleLaneEvent(event);
+			break;
+		default:
+			if (ARobotArm* arm = m_arms.IsValidIndex(event.id) ? m_arms[event.id].Get() : nullptr)
+				arm->HandleSimulationEvent(event.type);
+			break;
+		}
+	}
+
+	// Arms are drawn between the two last steps
+	TArray<float, TInlineAllocator<256>> times;
+	ReadSnapshots([this, &times](const FFactorySnapshot& previous, const FFactorySnapshot& current, float alpha) {
+		times.SetNumUninitialized(m_arms.Num());
+		for (int32 i = 0; i < m_arms.Num(); ++i) {
+			const float to = current.armTimes.IsValidIndex(i) ? current.armTimes[i] : 0;
+			float from = previous.armTimes.IsValidIndex(i) ? previous.armTimes[i] : to;
+			// Cycle wrapped between both steps
+			if (from > to)
+				from -= 1;
+			times[i] = FMath::Frac(FMath::Lerp(from, to, alpha));
+		}
+	});
+
+	for (int32 i = 0; i < m_arms.Num(); ++i)
+		if (ARobotArm* arm = m_arms[i].Get())
+			arm->SetSimulationTime(times[i]);
+}
+
+bool UFactorySubsystem::IsTickable() const {
+	return !HasAnyFlags(RF_ClassDefaultObject);
+}
+
+TStatId UFactorySubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UFactorySubsystem, STATGROUP_Tickables);
+}
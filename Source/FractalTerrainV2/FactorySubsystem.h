@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "FactorySimulation.h"
+#include "FactorySubsystem.generated.h"
+
+class ABeltNetwork;
+class ARobotArm;
+class FRunnableThread;
+class FFactorySimulationRunnable;
+
+/**
+	Runs the factory simulation at a fixed step on its own thread. The game
+	thread edits it through Access, reads the two last snapshots to draw
+	in between them and receives its events on tick.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API UFactorySubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UFactorySubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/*
+		Calls function with the simulation, the worker waits meanwhile.
+	*/
+	template<typename Function>
+	auto Access(Function&& function) -> decltype(function(DeclVal<FFactorySimulation&>())) {
+		FScopeLock lock(&m_lock);
+		return function(m_simulation);
+	}
+
+	/*
+		Calls reader with the snapshots of the two last steps and how far
+		the game is between them, in [0, 1].
+	*/
+	void ReadSnapshots(TFunctionRef<void(const FFactorySnapshot& previous, const FFactorySnapshot& current, float alpha)> reader);
+
+	/*
+		Simulates given time at once, to catch up on time the factory was
+		not running.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Factory")
+	void FastForward(float seconds);
+
+	void SetBeltNetwork(ABeltNetwork* network) {
+		m_beltNetwork = network;
+	}
+
+	/*
+		Adds an arm to the simulation, cycling rate times per second.
+		Returns its simulation index.
+	*/
+	int32 AddArm(ARobotArm* arm, float rate);
+	void RemoveArm(int32 index);
+
+	/*
+		Links arms to the lanes of the belts they work with, to call when
+		lanes change.
+	*/
+	void RelinkArms();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	friend class FFactorySimulationRunnable;
+
+	// One simulation step and its snapshot, on the worker
+	void step();
+
+	void linkArm(int32 index);
+	// Once the simulation dropped the arm, heldItem being what it held
+	void closeArmLinks(int32 index, int32 heldItem);
+
+	FFactorySimulation m_simulation;
+	FCriticalSection m_lock;
+
+	FFactorySnapshot m_previous;
+	FFactorySnapshot m_current;
+	TArray<FFactoryEvent> m_events;
+
+	FFactorySimulationRunnable* m_runnable;
+	FRunnableThread* m_thread;
+	// Steps on the game thread when there is no worker
+	float m_accumulator;
+
+	TWeakObjectPtr<ABeltNetwork> m_beltNetwork;
+	// By simulation arm index
+	TArray<TWeakObjectPtr<ARobotArm>> m_arms;
+	// Links opened on the inventories of arm machines
+	TArray<FMachineLinkPtr> m_armSourceLinks;
+	TArray<FMachineLinkPtr> m_armDestinationLinks;
+};
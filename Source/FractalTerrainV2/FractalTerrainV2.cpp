@@ -2,5 +2,16 @@
 
 #include "FractalTerrainV2.h"
 #include "Modules/ModuleManager.h"
+#include "Misc/Paths.h"
+#include "ShaderCore.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, FractalTerrainV2, "FractalTerrainV2" );
+class FFractalTerrainV2Module : public FDefaultGameModuleImpl {
+public:
+	virtual void StartupModule() override {
+		// Chunk vertex factory shaders, the module loads in PostConfigInit so
+		// the mapping exists before shader types are compiled
+		AddShaderSourceDirectoryMapping(TEXT("/Project"), FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders")));
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FFractalTerrainV2Module, FractalTerrainV2, "FractalTerrainV2" );
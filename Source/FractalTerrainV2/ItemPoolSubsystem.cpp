@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ItemPoolSubsystem.h"
+
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_STATS_GROUP(TEXT("ItemPool"), STATGROUP_ItemPool, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Acquire"), STAT_ItemPoolAcquire, STATGROUP_ItemPool);
+DECLARE_CYCLE_STAT(TEXT("Release"), STAT_ItemPoolRelease, STATGROUP_ItemPool);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Items spawned"), STAT_ItemPoolSpawned, STATGROUP_ItemPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pooled items"), STAT_ItemPoolTotal, STATGROUP_ItemPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active items"), STAT_ItemPoolActive, STATGROUP_ItemPool);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active items high water mark"), STAT_ItemPoolHighWaterMark, STATGROUP_ItemPool);
+
+static FAutoConsoleCommandWithWorld ItemPoolStatsCommand(
+	TEXT("ItemPool.Stats"),
+	TEXT("Logs the size, use and high water mark of each item pool."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+		if (UGameInstance* gameInstance = world ? world->GetGameInstance() : nullptr)
+			gameInstance->GetSubsystem<UItemPoolSubsystem>()->LogStats();
+	}));
+
+UItemPoolSubsystem::UItemPoolSubsystem() :
+	MinGrowth(8)
+{
+}
+
+void UItemPoolSubsystem::Deinitialize() {
+	m_pools.Empty();
+	updateStats();
+
+	Super::Deinitialize();
+}
+
+FItemPool* UItemPoolSubsystem::findPool(UClass* itemClass) {
+	UWorld* world = GetGameInstance()->GetWorld();
+	if (m_world.Get() != world) {
+		m_pools.Empty();
+		m_world = world;
+	}
+	return world ? &m_pools.FindOrAdd(itemClass) : nullptr;
+}
+
+AActor* UItemPoolSubsystem::Acquire(TSubclassOf<AActor> itemClass, const FTransform& transform) {
+	SCOPE_CYCLE_COUNTER(STAT_ItemPoolAcquire);
+
+	FItemPool* pool = itemClass ? findPool(itemClass) : nullptr;
+	if (!pool)
+		return nullptr;
+
+	// Items destroyed by someone else are dropped
+	AActor* item = nullptr;
+	while (!item && pool->Free.Num() > 0) {
+		item = pool->Free.Pop(false);
+		if (!IsValid(item)) {
+			item = nullptr;
+			--pool->Total;
+		}
+	}
+	if (!item) {
+		grow(itemClass, *pool, FMath::Max(MinGrowth, pool->Total / 2));
+		if (pool->Free.Num() == 0)
+			return nullptr;
+		item = pool->Free.Pop(false);
+	}
+
+	item->SetActorTransform(transform, false, nullptr, ETeleportType::ResetPhysics);
+	item->SetActorHiddenInGame(false);
+	item->SetActorEnableCollision(true);
+	item->SetActorTickEnabled(item->PrimaryActorTick.bStartWithTickEnabled);
+	// Velocities only apply to a simulating body
+	if (UPrimitiveComponent* root = Cast<UPrimitiveComponent>(item->GetRootComponent())) {
+		root->SetSimulatePhysics(pool->bSimulatePhysics);
+		root->SetPhysicsLinearVelocity(FVector::ZeroVector);
+		root->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+	}
+
+	pool->InUse.Add(item);
+	++pool->Active;
+	pool->HighWaterMark = FMath::Max(pool->HighWaterMark, pool->Active);
+	updateStats();
+	return item;
+}
+
+void UItemPoolSubsystem::Release(AActor* item) {
+	SCOPE_CYCLE_COUNTER(STAT_ItemPoolRelease);
+
+	if (!IsValid(item))
+		return;
+
+	FItemPool* pool = findPool(item->GetClass());
+	if (!pool || pool->InUse.Remove(item) == 0) {
+		UE_LOG(LogTemp, Warning, TEXT("Item %s released but not in use, ignored."), *item->GetName());
+		return;
+	}
+
+	deactivate(item);
+	pool->Free.Add(item);
+	--pool->Active;
+	updateStats();
+}
+
+void UItemPoolSubsystem::Prewarm(TSubclassOf<AActor> itemClass, int32 count) {
+	FItemPool* pool = itemClass ? findPool(itemClass) : nullptr;
+	if (pool && pool->Total < count)
+		grow(itemClass, *pool, count - pool->Total);
+}
+
+void UItemPoolSubsystem::grow(UClass* itemClass, FItemPool& pool, int32 count) {
+	UWorld* world = m_world.Get();
+	FActorSpawnParameters params;
+	params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	pool.Free.Reserve(pool.Free.Num() + count);
+	for (int32 i = 0; i < count; ++i) {
+		AActor* item = world->SpawnActor<AActor>(itemClass, FTransform::Identity, params);
+		if (!item)
+			break;
+
+		if (pool.Total == 0)
+			if (UPrimitiveComponent* root = Cast<UPrimitiveComponent>(item->GetRootComponent()))
+				pool.bSimulatePhysics = root->IsSimulatingPhysics();
+
+		// Items destroyed by someone else leave the pool
+		item->OnDestroyed.AddUniqueDynamic(this, &UItemPoolSubsystem::handleItemDestroyed);
+
+		deactivate(item);
+		pool.Free.Add(item);
+		++pool.Total;
+		INC_DWORD_STAT(STAT_ItemPoolSpawned);
+	}
+}
+
+void UItemPoolSubsystem::handleItemDestroyed(AActor* item) {
+	FItemPool* pool = m_pools.Find(item->GetClass());
+	if (!pool)
+		return;
+
+	if (pool->InUse.Remove(item) > 0)
+		--pool->Active;
+	else if (pool->Free.Remove(item) == 0)
+		return;
+	--pool->Total;
+	updateStats();
+}
+
+void UItemPoolSubsystem::deactivate(AActor* item) {
+	if (UPrimitiveComponent* root = Cast<UPrimitiveComponent>(item->GetRootComponent()))
+		root->SetSimulatePhysics(false);
+	item->SetActorHiddenInGame(true);
+	item->SetActorEnableCollision(false);
+	item->SetActorTickEnabled(false);
+}
+
+void UItemPoolSubsystem::updateStats() const {
+#if STATS
+	int32 total = 0;
+	int32 active = 0;
+	int32 highWaterMark = 0;
+	for (const TPair<UClass*, FItemPool>& pool : m_pools) {
+		total += pool.Value.Total;
+		active += pool.Value.Active;
+		highWaterMark += pool.Value.HighWaterMark;
+	}
+	SET_DWORD_STAT(STAT_ItemPoolTotal, total);
+	SET_DWORD_STAT(STAT_ItemPoolActive, active);
+	SET_DWORD_STAT(STAT_ItemPoolHighWaterMark, highWaterMark);
+#endif
+}
+
+void UItemPoolSubsystem::LogStats() const {
+	for (const TPair<UClass*, FItemPool>& pool : m_pools)
+		UE_LOG(LogTemp, Display, TEXT("Item pool %s: %d items, %d active, high water mark %d"),
+			*GetNameSafe(pool.Key), pool.Value.Total, pool.Value.Active, pool.Value.HighWaterMark);
+}
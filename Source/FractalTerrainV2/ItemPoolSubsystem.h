@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "ItemPoolSubsystem.generated.h"
+
+USTRUCT()
+struct FItemPool {
+	GENERATED_BODY()
+
+	// Hidden actors ready to be handed out
+	UPROPERTY()
+	TArray<AActor*> Free;
+
+	// Items handed out and not released yet
+	UPROPERTY()
+	TSet<AActor*> InUse;
+
+	int32 Total = 0;
+	int32 Active = 0;
+	int32 HighWaterMark = 0;
+	// Whether the item root simulates physics when in use
+	bool bSimulatePhysics = false;
+};
+
+/**
+	Keeps item actors (ores, moved items) around instead of spawning and
+	destroying them. Released items are hidden, without collision, tick or
+	physics, and handed out again with their physics reset. Pools grow when
+	they run out.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API UItemPoolSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UItemPoolSubsystem();
+
+	virtual void Deinitialize() override;
+
+	/*
+		Returns an item of given class at transform, spawning more items if
+		the pool is empty.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "ItemPool")
+	AActor* Acquire(TSubclassOf<AActor> itemClass, const FTransform& transform);
+
+	/*
+		Gives an item back. Items not handed out by Acquire, or already
+		released, are ignored with a warning.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "ItemPool")
+	void Release(AActor* item);
+
+	/*
+		Spawns items ahead so the pool holds at least count of them.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "ItemPool")
+	void Prewarm(TSubclassOf<AActor> itemClass, int32 count);
+
+	// Logs each pool size, use and high water mark
+	void LogStats() const;
+
+	// Items spawned at least when a pool grows
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ItemPool")
+	int32 MinGrowth;
+
+private:
+	// Pools of the current world, emptied when it changes
+	FItemPool* findPool(UClass* itemClass);
+	void grow(UClass* itemClass, FItemPool& pool, int32 count);
+	void deactivate(AActor* item);
+
+	UFUNCTION()
+	void handleItemDestroyed(AActor* item);
+	void updateStats() const;
+
+	UPROPERTY()
+	TMap<UClass*, FItemPool> m_pools;
+	TWeakObjectPtr<UWorld> m_world;
+};
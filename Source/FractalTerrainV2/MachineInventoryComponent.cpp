@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MachineInventoryComponent.h"
+#include "MachineSignalComponent.h"
+
+UMachineInventoryComponent::UMachineInventoryComponent() :
+	SlotCount(8),
+	LinkCapacity(4),
+	m_first(0),
+	m_count(0),
+	m_nextOutput(0)
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UMachineInventoryComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	m_slots.SetNumZeroed(FMath::Max(SlotCount, 1));
+}
+
+bool UMachineInventoryComponent::AddItem(int32 type) {
+	if (m_count == m_slots.Num() || type < 0 || type > MAX_uint8)
+		return false;
+
+	m_slots[(m_first + m_count) % m_slots.Num()] = static_cast<uint8>(type);
+	if (++m_count == 1)
+		if (UMachineSignalComponent* signals = UMachineSignalComponent::Find(GetOwner()))
+			signals->SignalItemAvailable();
+	return true;
+}
+
+int32 UMachineInventoryComponent::TakeItem() {
+	if (m_count == 0)
+		return -1;
+
+	const int32 type = m_slots[m_first];
+	m_first = (m_first + 1) % m_slots.Num();
+	if (m_count-- == m_slots.Num())
+		if (UMachineSignalComponent* signals = UMachineSignalComponent::Find(GetOwner()))
+			signals->SignalSlotFree();
+	return type;
+}
+
+FMachineLinkPtr UMachineInventoryComponent::OpenOutput() {
+	FMachineLinkPtr link = MakeShared<FMachineLink, ESPMode::ThreadSafe>(LinkCapacity);
+	m_outputs.Add(link);
+	return link;
+}
+
+FMachineLinkPtr UMachineInventoryComponent::OpenInput() {
+	FMachineLinkPtr link = MakeShared<FMachineLink, ESPMode::ThreadSafe>(LinkCapacity);
+	m_inputs.Add(link);
+	return link;
+}
+
+void UMachineInventoryComponent::CloseLink(const FMachineLinkPtr& link) {
+	if (m_inputs.Remove(link) + m_outputs.Remove(link) == 0)
+		return;
+
+	uint8 item;
+	int32 lost = 0;
+	while (link->Pop(item))
+		if (!AddItem(item))
+			++lost;
+	if (lost > 0)
+		UE_LOG(LogTemp, Warning, TEXT("%d items of a closed link did not fit in %s, lost."), lost, *GetNameSafe(GetOwner()));
+}
+
+void UMachineInventoryComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	uint8 item;
+	for (const FMachineLinkPtr& input : m_inputs)
+		while (m_count < m_slots.Num() && input->Pop(item))
+			AddItem(item);
+
+	// One item per output in turn, until items or room run out
+	int32 full = 0;
+	while (m_count > 0 && full < m_outputs.Num()) {
+		m_nextOutput %= m_outputs.Num();
+		if (m_outputs[m_nextOutput]->Push(m_slots[m_first])) {
+			TakeItem();
+			full = 0;
+		} else
+			++full;
+		++m_nextOutput;
+	}
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "MachineLink.h"
+#include "MachineInventoryComponent.generated.h"
+
+/**
+	Items held by a machine, in a fixed number of slots, and the links it
+	trades them through. Items are item types, no actor is spawned for
+	them. Slots belong to the game thread, links may have their other end
+	on the simulation thread. Each tick, inputs are collected into free
+	slots and held items are handed to outputs in turn.
+ */
+UCLASS(ClassGroup = (Factory), meta = (BlueprintSpawnableComponent))
+class FRACTALTERRAINV2_API UMachineInventoryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UMachineInventoryComponent();
+
+	// Inventory of machine, nullptr if it has none
+	static UMachineInventoryComponent* Find(AActor* machine) {
+		return machine ? machine->FindComponentByClass<UMachineInventoryComponent>() : nullptr;
+	}
+
+	/*
+		Puts an item in a free slot, fails if every slot is taken.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Machine")
+	bool AddItem(int32 type);
+
+	/*
+		Takes the oldest item held, returns its type or -1.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Machine")
+	int32 TakeItem();
+
+	UFUNCTION(BlueprintCallable, Category = "Machine")
+	int32 GetItemCount() const {
+		return m_count;
+	}
+
+	/*
+		Opens a link items leave the machine through, the caller consumes
+		its other end.
+	*/
+	FMachineLinkPtr OpenOutput();
+
+	/*
+		Opens a link items enter the machine through, the caller produces
+		into its other end.
+	*/
+	FMachineLinkPtr OpenInput();
+
+	/*
+		Forgets a link, its other end must be released first. Items still
+		in it are put back in the slots, those left without a slot are lost.
+	*/
+	void CloseLink(const FMachineLinkPtr& link);
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Machine")
+	int32 SlotCount;
+
+	// Items each link can hold in flight
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Machine")
+	int32 LinkCapacity;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	// Ring of held items, oldest at m_first
+	TArray<uint8> m_slots;
+	int32 m_first;
+	int32 m_count;
+
+	TArray<FMachineLinkPtr> m_inputs;
+	TArray<FMachineLinkPtr> m_outputs;
+	// Output served first next time, so outputs share items
+	int32 m_nextOutput;
+};
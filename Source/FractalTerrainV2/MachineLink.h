@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+
+/**
+	Items handed from one machine to the next, in order. Lock free ring
+	buffer holding exactly capacity items, a handoff only moves its head
+	or tail: safe with one producer and one consumer, each on its own
+	thread.
+ */
+class FMachineLink {
+public:
+	// One slot stays empty so a full ring differs from an empty one
+	explicit FMachineLink(uint32 capacity) :
+		m_size(FMath::Max(capacity, 1u) + 1),
+		m_head(0),
+		m_tail(0)
+	{
+		m_items.SetNumZeroed(m_size);
+	}
+
+	// Producer side
+	bool Push(uint8 item) {
+		const uint32 tail = m_tail.Load(EMemoryOrder::Relaxed);
+		const uint32 next = (tail + 1) % m_size;
+		if (next == m_head.Load())
+			return false;
+		m_items[tail] = item;
+		m_tail.Store(next);
+		return true;
+	}
+
+	bool IsFull() const {
+		return (m_tail.Load() + 1) % m_size == m_head.Load();
+	}
+
+	// Consumer side
+	bool Pop(uint8& item) {
+		const uint32 head = m_head.Load(EMemoryOrder::Relaxed);
+		if (head == m_tail.Load())
+			return false;
+		item = m_items[head];
+		m_head.Store((head + 1) % m_size);
+		return true;
+	}
+
+	bool IsEmpty() const {
+		return m_head.Load() == m_tail.Load();
+	}
+
+private:
+	TArray<uint8> m_items;
+	const uint32 m_size;
+	// Next item to pop, next slot to push
+	TAtomic<uint32> m_head;
+	TAtomic<uint32> m_tail;
+};
+
+typedef TSharedPtr<FMachineLink, ESPMode::ThreadSafe> FMachineLinkPtr;
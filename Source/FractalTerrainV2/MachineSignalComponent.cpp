@@ -0,0 +1,10 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MachineSignalComponent.h"
+
+UMachineSignalComponent::UMachineSignalComponent() :
+	bSignalsEveryWait(true)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+}
@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "MachineSignalComponent.generated.h"
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnMachineSignal, AActor* /* machine */);
+
+/**
+	Lets a machine (belt, drill...) tell the arms working with it that an
+	item can be picked or that a slot can take one, so waiting arms sleep
+	instead of polling it every tick.
+	Signals are sent by the machine, native or from its Blueprint.
+	Arms keep polling machines without this component, or with
+	bSignalsEveryWait cleared, every tick while they wait on them.
+ */
+UCLASS(ClassGroup = (Factory), meta = (BlueprintSpawnableComponent))
+class FRACTALTERRAINV2_API UMachineSignalComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UMachineSignalComponent();
+
+	UFUNCTION(BlueprintCallable, Category = "Machine")
+	void SignalItemAvailable() {
+		OnItemAvailable.Broadcast(GetOwner());
+	}
+
+	UFUNCTION(BlueprintCallable, Category = "Machine")
+	void SignalSlotFree() {
+		OnSlotFree.Broadcast(GetOwner());
+	}
+
+	// Signal component of machine, nullptr if it has none
+	static UMachineSignalComponent* Find(AActor* machine) {
+		return machine ? machine->FindComponentByClass<UMachineSignalComponent>() : nullptr;
+	}
+
+	FOnMachineSignal OnItemAvailable;
+	FOnMachineSignal OnSlotFree;
+
+	// Whether the machine signals every item and slot an arm may wait on.
+	// Arms sleep only on such machines and keep polling the others.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Machine")
+	bool bSignalsEveryWait;
+};
@@ -4,6 +4,7 @@
 #include "MyCharacter.h"
 
 #include "Terrain.h"
+#include "VoxelMovementComponent.h"
 #include "Components/StaticMeshComponent.h"
 
 #include "Engine/World.h"
@@ -16,13 +17,18 @@
 
 
 // Sets default values
-AMyCharacter::AMyCharacter()
+AMyCharacter::AMyCharacter(const FObjectInitializer& ObjectInitializer) :
+	Super(ObjectInitializer.SetDefaultSubobjectClass<UVoxelMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 	m_terrain = nullptr;
-	m_hasMoved = false;
+	m_chunkTicket = -1;
+	m_viewTicket = -1;
+	ChunkLoadRadius = 1;
 	m_actionMode = BREAK_BLOCKS;
+	m_ghost = nullptr;
+	m_ghostPlaceable = EPlaceable::Foreuse;
 }
 
 // Called when the game starts or when spawned
@@ -39,32 +45,32 @@ void AMyCharacter::BeginPlay()
 		UE_LOG(LogTemp, Error, TEXT("NO TERRAIN ATTACHED TO CHARACTER"));
 		return;
 	}
+
+	// Keep chunks around us loaded, players take precedence over machines
+	m_chunkTicket = m_terrain->AddChunkTicket(this, ChunkLoadRadius, 1);
+
+	// Farther chunks use coarser LODs, loaded after the close ones
+	const int32 viewRadius = m_terrain->GetViewRadius();
+	if (viewRadius > ChunkLoadRadius)
+		m_viewTicket = m_terrain->AddChunkTicket(this, viewRadius, 0);
+}
+
+void AMyCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (m_terrain && !m_terrain->IsPendingKill() && m_chunkTicket >= 0)
+		m_terrain->RemoveChunkTicket(m_chunkTicket);
+	if (m_terrain && !m_terrain->IsPendingKill() && m_viewTicket >= 0)
+		m_terrain->RemoveChunkTicket(m_viewTicket);
+	m_chunkTicket = -1;
+	m_viewTicket = -1;
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void AMyCharacter::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
-	if (m_hasMoved) {
-		const FVector aLoc = GetActorLocation();
-		const FIntVector chkLoc = m_terrain->worldToChunkCoords(
-			aLoc.X,
-			aLoc.Y,
-			aLoc.Z);
-
-		for (int i = -1; i <= 1; ++i) {
-			for (int j = -1; j <= 1; ++j) {
-				for (int k = -1; k <= 1; ++k) {
-					const int64 chkIdx = m_terrain->getChunkIndex(
-						chkLoc.X + i,
-						chkLoc.Y + j,
-						chkLoc.Z + k);
-					m_terrain->loadChunk(chkIdx);
-				}
-			}
-		}
-	}
-
 	if (m_actionMode == SPAWN_OBJECT && m_ghost) {
 		APlayerCameraManager* cameraMgr = UGameplayStatics::GetPlayerCameraManager(GetWorld(), 0);
 		const FVector forward = cameraMgr->GetCameraRotation().Vector();
@@ -72,7 +78,9 @@ void AMyCharacter::Tick(float DeltaTime)
 		const FVector end = start + (forward * 1000);
 		FIntVector blockCoords;
 		FVector coords;
-		if (m_terrain->Raycast(start, end, blockCoords, coords)) {
+		// Surface index answers most cases without tracing chunk meshes
+		if (m_terrain->RaycastSurface(start, end, blockCoords) ||
+			m_terrain->Raycast(start, end, blockCoords, coords)) {
 			FVector spawnCoord = m_terrain->getBlockSideCoord(blockCoords);
 			// For depth fighting purposes
 			spawnCoord.Z += 1;
@@ -121,7 +129,6 @@ void AMyCharacter::MoveForward(float Value)
 	APlayerCameraManager* cameraMgr = UGameplayStatics::GetPlayerCameraManager(GetWorld(), 0);
 	const FVector Direction = cameraMgr->GetCameraRotation().Vector();
 	AddMovementInput(Direction, Value);
-	m_hasMoved = true;
 }
 
 void AMyCharacter::MoveRight(float Value)
@@ -129,7 +136,6 @@ void AMyCharacter::MoveRight(float Value)
 	// Find out which way is "right" and record that the player wants to move that way.
 	FVector Direction = FRotationMatrix(Controller->GetControlRotation()).GetScaledAxis(EAxis::Y);
 	AddMovementInput(Direction, Value);
-	m_hasMoved = true;
 }
 
 void AMyCharacter::Scroll(float value) {
@@ -165,45 +171,61 @@ void AMyCharacter::Hit()
 		break;
 	case SPAWN_OBJECT:
 		if (m_ghost) {
-			UObject* SpawnActor = Cast<UObject>(
-				StaticLoadObject(UObject::StaticClass(), NULL, *m_ghostBlueprintResName));
-			UBlueprint* GeneratedBP = Cast<UBlueprint>(SpawnActor);
+			UClass* actorClass = GetGameInstance()->GetSubsystem<UPlaceableCatalogSubsystem>()->GetActorClass(m_ghostPlaceable);
+			if (!actorClass)
+				break;
+			// Machines and ground are checked on the voxel grid, not by
+			// physics overlaps
+			const FBox bounds = m_ghost->GetStaticMeshComponent()->Bounds.GetBox();
+			FIntVector minCell, maxCell;
+			m_terrain->GetBoxCells(bounds, minCell, maxCell);
+			const FBox inner = bounds.ExpandBy(-m_terrain->VoxelSize * 0.1f);
+			if (m_terrain->IsOccupied(minCell, maxCell) || m_terrain->OverlapsSolid(inner))
+				break;
+
+			// Pawns and loose items are not on the grid, a single overlap
+			// query on their channels covers them
+			UWorld* World = GetWorld();
+			FCollisionObjectQueryParams movingObjects;
+			movingObjects.AddObjectTypesToQuery(ECC_Pawn);
+			movingObjects.AddObjectTypesToQuery(ECC_PhysicsBody);
+			if (World->OverlapAnyTestByObjectType(inner.GetCenter(), FQuat::Identity, movingObjects, FCollisionShape::MakeBox(inner.GetExtent())))
+				break;
+
 			const FVector loc = m_ghost->GetActorLocation();
 			const FRotator rot = m_ghost->GetActorRotation();
-			UWorld* World = GetWorld();
 			FActorSpawnParameters SpawnParams;
 			SpawnParams.Owner = this;
-			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::DontSpawnIfColliding;
-			AActor *actor  = World->SpawnActor<AActor>(GeneratedBP->GeneratedClass, loc, rot, SpawnParams);
+			SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			AActor *actor  = World->SpawnActor<AActor>(actorClass, loc, rot, SpawnParams);
 			if (actor) {
 				actor->DisableComponentsSimulatePhysics();
 				actor->DispatchBeginPlay();
+				// Machines without their own registration hold the ghost cells
+				if (!m_terrain->IsOccupant(actor))
+					m_terrain->AddOccupant(actor, minCell, maxCell);
 			}
 		}
 		break;
 	case SELECT_OBJECT:
-		struct FHitResult hitResult;
-		struct FCollisionQueryParams queryParams;
-		queryParams.AddIgnoredActor(this);
-		if (GetWorld()->LineTraceSingleByChannel(
-			hitResult,
-			start,
-			end,
-			ECC_WorldStatic,
-			queryParams)) {
-			m_selected = hitResult.Actor.Get();
+		if (AActor* selected = m_terrain->RaycastOccupant(start, end)) {
+			m_selected = selected;
 			DispatchEvent();
 		}
 		break;
 	}
 }
 
-void AMyCharacter::SetGhost(const FString &resName) {
-	UMaterialInterface* material = Cast<UMaterialInterface>(
-		StaticLoadObject(UMaterialInterface::StaticClass(), NULL, TEXT("/Game/Materials/Ghost.Ghost")));
-
-	UStaticMesh* staticMesh = Cast<UStaticMesh>(
-		StaticLoadObject(UObject::StaticClass(), NULL, *resName));
+void AMyCharacter::SetGhost(EPlaceable placeable) {
+	// Assets are preloaded, nothing to place until they are
+	const UPlaceableCatalogSubsystem* catalog = GetGameInstance()->GetSubsystem<UPlaceableCatalogSubsystem>();
+	UMaterialInterface* material = catalog->GetGhostMaterial();
+	UStaticMesh* staticMesh = catalog->GetMesh(placeable);
+	if (!staticMesh) {
+		UE_LOG(LogTemp, Warning, TEXT("Placeable assets are not loaded yet."));
+		return;
+	}
+	m_ghostPlaceable = placeable;
 
 	m_ghost = (AStaticMeshActor*)GetWorld()->SpawnActor(AStaticMeshActor::StaticClass());
 	m_ghost->SetMobility(EComponentMobility::Movable);
@@ -230,18 +252,15 @@ void AMyCharacter::SetActionMode(int mode) {
 		m_actionMode = SELECT_OBJECT;
 		break;
 	case 2:
-		SetGhost(TEXT("StaticMesh'/Game/Assets/foreuse_v3.foreuse_v3'"));
-		m_ghostBlueprintResName = TEXT("Blueprint'/Game/Actors/Foreuse.Foreuse'");
+		SetGhost(EPlaceable::Foreuse);
 		m_actionMode = SPAWN_OBJECT;
 		break;
 	case 3:
-		SetGhost(TEXT("StaticMesh'/Game/Assets/Belt/belt_straight.belt_straight'"));
-		m_ghostBlueprintResName = TEXT("Blueprint'/Game/Actors/Belt_BP.Belt_BP'");
+		SetGhost(EPlaceable::Belt);
 		m_actionMode = SPAWN_OBJECT;
 		break;
 	case 4:
-		SetGhost(TEXT("StaticMesh'/Game/Assets/Arm/Arm_SM.Arm_SM'"));
-		m_ghostBlueprintResName = TEXT("Blueprint'/Game/Actors/RobotArm_BP.RobotArm_BP'");
+		SetGhost(EPlaceable::RobotArm);
 		m_actionMode = SPAWN_OBJECT;
 		break;
 	default:
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "PlaceableCatalogSubsystem.h"
 #include "MyCharacter.generated.h"
 
 class ATerrain;
@@ -22,7 +23,7 @@ class FRACTALTERRAINV2_API AMyCharacter : public ACharacter
 public:
 
 	// Sets default values for this character's properties
-	AMyCharacter();
+	AMyCharacter(const FObjectInitializer& ObjectInitializer);
 
 protected:
 	enum ActionMode {
@@ -34,18 +35,22 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-	void SetGhost(const FString &resName);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void SetGhost(EPlaceable placeable);
 
 	void DispatchEvent();
 
 	ATerrain* m_terrain;
-	bool m_hasMoved;
+	int32 m_chunkTicket;
+	// Keeps coarse LOD chunks loaded out to the terrain view radius
+	int32 m_viewTicket;
 
 	ActionMode m_actionMode;
 
 	// Used when placing object
 	AStaticMeshActor* m_ghost;
-	FString m_ghostBlueprintResName;
+	EPlaceable m_ghostPlaceable;
 
 	// Used for selection
 	AActor* m_selected;
@@ -54,6 +59,10 @@ protected:
 	TArray<CharacterEventListener*> m_listenersToRemove;
 
 public:
+	// Radius (in chunks) kept loaded around the character
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Terrain")
+	int32 ChunkLoadRadius;
+
 	void AddSelectListener(CharacterEventListener* listener);
 	void RemoveSelectListener(CharacterEventListener* listener);
 
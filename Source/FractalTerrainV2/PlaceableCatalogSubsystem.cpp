@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlaceableCatalogSubsystem.h"
+
+#include "Engine/StaticMesh.h"
+#include "Materials/MaterialInterface.h"
+
+UPlaceableCatalogSubsystem::UPlaceableCatalogSubsystem() :
+	m_loaded(false),
+	m_ghostMaterial(nullptr)
+{
+}
+
+void UPlaceableCatalogSubsystem::Initialize(FSubsystemCollectionBase& Collection) {
+	Super::Initialize(Collection);
+
+	// Same order as EPlaceable, classes are the generated classes of the
+	// actor Blueprints
+	m_meshPaths = {
+		FSoftObjectPath(TEXT("/Game/Assets/foreuse_v3.foreuse_v3")),
+		FSoftObjectPath(TEXT("/Game/Assets/Belt/belt_straight.belt_straight")),
+		FSoftObjectPath(TEXT("/Game/Assets/Arm/Arm_SM.Arm_SM")),
+	};
+	m_classPaths = {
+		FSoftClassPath(TEXT("/Game/Actors/Foreuse.Foreuse_C")),
+		FSoftClassPath(TEXT("/Game/Actors/Belt_BP.Belt_BP_C")),
+		FSoftClassPath(TEXT("/Game/Actors/RobotArm_BP.RobotArm_BP_C")),
+	};
+	m_ghostMaterialPath = FSoftObjectPath(TEXT("/Game/Materials/Ghost.Ghost"));
+	check(m_meshPaths.Num() == static_cast<int32>(EPlaceable::Count));
+	check(m_classPaths.Num() == static_cast<int32>(EPlaceable::Count));
+
+	TArray<FSoftObjectPath> paths(m_meshPaths);
+	paths.Append(m_classPaths);
+	paths.Add(m_ghostMaterialPath);
+	m_handle = m_streamable.RequestAsyncLoad(paths,
+		FStreamableDelegate::CreateUObject(this, &UPlaceableCatalogSubsystem::handleLoaded),
+		FStreamableManager::AsyncLoadHighPriority);
+}
+
+void UPlaceableCatalogSubsystem::Deinitialize() {
+	if (m_handle.IsValid()) {
+		m_handle->CancelHandle();
+		m_handle.Reset();
+	}
+	m_meshes.Empty();
+	m_classes.Empty();
+	m_ghostMaterial = nullptr;
+	m_loaded = false;
+
+	Super::Deinitialize();
+}
+
+void UPlaceableCatalogSubsystem::handleLoaded() {
+	m_meshes.SetNum(m_meshPaths.Num());
+	for (int32 i = 0; i < m_meshPaths.Num(); ++i) {
+		m_meshes[i] = Cast<UStaticMesh>(m_meshPaths[i].ResolveObject());
+		if (!m_meshes[i])
+			UE_LOG(LogTemp, Error, TEXT("Placeable mesh %s could not be loaded."), *m_meshPaths[i].ToString());
+	}
+
+	m_classes.SetNum(m_classPaths.Num());
+	for (int32 i = 0; i < m_classPaths.Num(); ++i) {
+		m_classes[i] = m_classPaths[i].ResolveClass();
+		if (!m_classes[i])
+			UE_LOG(LogTemp, Error, TEXT("Placeable class %s could not be loaded."), *m_classPaths[i].ToString());
+	}
+
+	m_ghostMaterial = Cast<UMaterialInterface>(m_ghostMaterialPath.ResolveObject());
+	if (!m_ghostMaterial)
+		UE_LOG(LogTemp, Error, TEXT("Ghost material %s could not be loaded."), *m_ghostMaterialPath.ToString());
+
+	m_loaded = true;
+}
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Engine/StreamableManager.h"
+#include "PlaceableCatalogSubsystem.generated.h"
+
+class UMaterialInterface;
+class UStaticMesh;
+
+UENUM(BlueprintType)
+enum class EPlaceable : uint8 {
+	Foreuse,
+	Belt,
+	RobotArm,
+	Count UMETA(Hidden)
+};
+
+/**
+	Assets of the objects the player places: ghost mesh and actor class of
+	each placeable, and the ghost material. All are loaded asynchronously
+	when the game starts, so placing never loads from disk. Getters return
+	nullptr until loading is done.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API UPlaceableCatalogSubsystem : public UGameInstanceSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UPlaceableCatalogSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	UFUNCTION(BlueprintCallable, Category = "Placeable")
+	bool IsLoaded() const {
+		return m_loaded;
+	}
+
+	UFUNCTION(BlueprintCallable, Category = "Placeable")
+	UStaticMesh* GetMesh(EPlaceable placeable) const {
+		return m_meshes.IsValidIndex(static_cast<int32>(placeable)) ? m_meshes[static_cast<int32>(placeable)] : nullptr;
+	}
+
+	UFUNCTION(BlueprintCallable, Category = "Placeable")
+	UClass* GetActorClass(EPlaceable placeable) const {
+		return m_classes.IsValidIndex(static_cast<int32>(placeable)) ? m_classes[static_cast<int32>(placeable)] : nullptr;
+	}
+
+	UFUNCTION(BlueprintCallable, Category = "Placeable")
+	UMaterialInterface* GetGhostMaterial() const {
+		return m_ghostMaterial;
+	}
+
+private:
+	// Resolves every asset once the load completes
+	void handleLoaded();
+
+	FStreamableManager m_streamable;
+	TSharedPtr<FStreamableHandle> m_handle;
+	bool m_loaded;
+
+	// By placeable
+	TArray<FSoftObjectPath> m_meshPaths;
+	TArray<FSoftClassPath> m_classPaths;
+	FSoftObjectPath m_ghostMaterialPath;
+
+	UPROPERTY()
+	TArray<UStaticMesh*> m_meshes;
+	UPROPERTY()
+	TArray<UClass*> m_classes;
+	UPROPERTY()
+	UMaterialInterface* m_ghostMaterial;
+};
@@ -2,10 +2,15 @@
 
 
 #include "RobotArm.h"
+#include "FactorySubsystem.h"
+#include "MachineSignalComponent.h"
+#include "RobotArmSubsystem.h"
+#include "Terrain.h"
 #include "Kismet/GameplayStatics.h"
 
 #include "Components/PoseableMeshComponent.h"
 #include "Components/SphereComponent.h"
+#include "Curves/CurveFloat.h"
 
 #include <cmath>
 
@@ -13,6 +18,7 @@
 ARobotArm::ARobotArm() :
 	Src(NULL),
 	Dst(NULL),
+	PickedItemType(-1),
 	BoneAxes{
 		EAxis::Z,
 		EAxis::X,
@@ -23,10 +29,19 @@ ARobotArm::ARobotArm() :
 	},
 	ArmSpeed(50),
 	WaitDrop(false),
-	WaitPick(false)
+	WaitPick(false),
+	Terrain(nullptr),
+	TerrainTicket(-1),
+	TerrainOccupant(-1),
+	Animation(nullptr),
+	AnimationHandle(-1),
+	Factory(nullptr),
+	FactoryArm(-1),
+	CycleLength(1)
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	// Only ticks to poll machines that do not signal
 	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 	SetActorTickInterval(1000);
 }
 
@@ -34,18 +49,51 @@ ARobotArm::ARobotArm() :
 void ARobotArm::BeginPlay()
 {
 	Super::BeginPlay();
+
+	TArray<AActor*> actors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ATerrain::StaticClass(), actors);
+	if (actors.Num() == 1) {
+		Terrain = static_cast<ATerrain*>(actors[0]);
+		TerrainTicket = Terrain->AddChunkTicket(this, 0, 0);
+		TerrainOccupant = Terrain->AddOccupant(this);
+	} else
+		UE_LOG(LogTemp, Warning, TEXT("Robot arm could not find terrain, chunks may unload under it."));
+}
+
+void ARobotArm::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (Terrain && !Terrain->IsPendingKill() && TerrainTicket >= 0)
+		Terrain->RemoveChunkTicket(TerrainTicket);
+	TerrainTicket = -1;
+	if (Terrain && !Terrain->IsPendingKill() && TerrainOccupant >= 0)
+		Terrain->RemoveOccupant(TerrainOccupant);
+	TerrainOccupant = -1;
+
+	if (Animation && AnimationHandle >= 0)
+		Animation->UnregisterArm(AnimationHandle);
+	AnimationHandle = -1;
+
+	if (Factory && FactoryArm >= 0)
+		Factory->RemoveArm(FactoryArm);
+	FactoryArm = -1;
+
+	if (UMachineSignalComponent* source = UMachineSignalComponent::Find(IsValid(Src) ? Src : nullptr))
+		source->OnItemAvailable.Remove(ItemAvailableHandle);
+	if (UMachineSignalComponent* destination = UMachineSignalComponent::Find(IsValid(Dst) ? Dst : nullptr))
+		destination->OnSlotFree.Remove(SlotFreeHandle);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void ARobotArm::Tick(float DeltaTime) {
 	Super::Tick(DeltaTime);
 
+	// Machines which may not signal the wait are polled, the arm sleeps on the others
 	if (WaitDrop)
 		HandleTryDrop();
 	else if (WaitPick)
 		HandleTryPick();
-	else 
-		Timeline.TickTimeline(DeltaTime);
 }
 
 void ARobotArm::SetSettingUp(bool value) {
@@ -80,12 +128,17 @@ void ARobotArm::OnSelect(AActor *selected) {
 	const FVector waitLoc = waitSlot->GetComponentLocation();
 	const FRotator waitRot = waitSlot->GetComponentRotation();
 
+	// Both slots of the machine in one solve
+	const FVector targets[2] = { waitLoc, pickUpLoc };
+	FRobotArmIKSolution solution;
+	GetIK().Solve(targets, 2, solution);
+
 	if (!Src) {
 		// Grip open by default
-		if (AddPathNode(waitLoc, waitRot, OPEN)) {
-			if (AddPathNode(pickUpLoc, pickUpRot, CLOSE)) {
+		if (AddPathNode(solution, 0, waitRot, OPEN)) {
+			if (AddPathNode(solution, 1, pickUpRot, CLOSE)) {
 				Src = selected;
-				AddPathNode(waitLoc, waitRot, CLOSE);
+				AddPathNode(solution, 0, waitRot, CLOSE);
 			} else
 				PopPathNode();
 		}
@@ -98,10 +151,10 @@ void ARobotArm::OnSelect(AActor *selected) {
 
 	// Dest
 	if (!Dst) {
-		if (AddPathNode(waitLoc, waitRot, CLOSE)) {
-			if (AddPathNode(pickUpLoc, pickUpRot, OPEN)) {
+		if (AddPathNode(solution, 0, waitRot, CLOSE)) {
+			if (AddPathNode(solution, 1, pickUpRot, OPEN)) {
 				Dst = selected;
-				AddPathNode(waitLoc, waitRot, OPEN);
+				AddPathNode(solution, 0, waitRot, OPEN);
 			} else
 				PopPathNode();
 		}
@@ -111,7 +164,6 @@ void ARobotArm::OnSelect(AActor *selected) {
 	// TODO: Improve this as it looks weird currently
 	const float dist = FVector::Dist(Src->GetActorLocation(), Dst->GetActorLocation());
 	const float rate = ArmSpeed / dist;
-	Timeline.SetPlayRate(rate);
 
 	// Remove selection listener
 	AMyCharacter* character = Cast<AMyCharacter>(
@@ -119,116 +171,91 @@ void ARobotArm::OnSelect(AActor *selected) {
 	character->RemoveSelectListener(this);
 	character->SetActionMode(1);
 
-	// Setup timeline
-	if (!curve) {
-		UE_LOG(LogTemp, Warning, TEXT("No curve for timeline!"));
-		return;
-	}
-
-	FOnTimelineFloat onProgressCallback;
-	FOnTimelineEvent onPickCallback;
-	FOnTimelineEvent onDropCallback;
-	FOnTimelineEvent onTryPickCallback;
-	FOnTimelineEvent onTryDropCallback;
-
-	FOnTimelineEventStatic onTimelineFinishedCallback;
-
-	onProgressCallback.BindUFunction(this, FName("HandleProgress"));
-	onTimelineFinishedCallback.BindUFunction(this, FName("HandleTimelineEnd"));
-	onPickCallback.BindUFunction(this, FName("OnPick"));
-	onDropCallback.BindUFunction(this, FName("OnDrop"));
-	onTryPickCallback.BindUFunction(this, FName("HandleTryPick"));
-	onTryDropCallback.BindUFunction(this, FName("HandleTryDrop"));
-
-	Timeline.AddEvent(1.f / 6, onPickCallback);
-	Timeline.AddEvent(4.f / 6, onDropCallback);
-
-	Timeline.AddEvent(0, onTryPickCallback);
-	Timeline.AddEvent(3.f / 6, onTryDropCallback);
-
-	Timeline.AddInterpFloat(curve, onProgressCallback);
-	Timeline.SetTimelineFinishedFunc(onTimelineFinishedCallback);
-	Timeline.SetLooping(true);
-	Timeline.PlayFromStart();
+	// Wake up when machines are ready instead of polling them
+	if (UMachineSignalComponent* source = UMachineSignalComponent::Find(Src))
+		ItemAvailableHandle = source->OnItemAvailable.AddUObject(this, &ARobotArm::HandleItemAvailable);
+	if (UMachineSignalComponent* destination = UMachineSignalComponent::Find(Dst))
+		SlotFreeHandle = destination->OnSlotFree.AddUObject(this, &ARobotArm::HandleSlotFree);
+
+	// Setup simulated cycle
+	if (curve) {
+		float start;
+		curve->GetTimeRange(start, CycleLength);
+		if (CycleLength <= 0)
+			CycleLength = 1;
+	} else
+		UE_LOG(LogTemp, Warning, TEXT("No curve for arm cycle!"));
+
+	Factory = GetGameInstance()->GetSubsystem<UFactorySubsystem>();
+	if (FactoryArm < 0)
+		FactoryArm = Factory->AddArm(this, rate / CycleLength);
+
+	Animation = GetGameInstance()->GetSubsystem<URobotArmSubsystem>();
+	if (AnimationHandle < 0)
+		AnimationHandle = Animation->RegisterArm(
+			Cast<UPoseableMeshComponent>(RootComponent), BoneIndices, BoneAxes, PathAngles);
 }
 
-bool ARobotArm::AddPathNode(const FVector& actualTarget, const FRotator &orientation, GripAction gripAction) {
+FRobotArmIK ARobotArm::GetIK() const {
+	FRobotArmIK ik;
 	UPoseableMeshComponent* armMesh = Cast<UPoseableMeshComponent>(RootComponent);
+	if (!armMesh || BoneNames.Num() < 6)
+		return ik;
 
-	const FVector actorLocation = GetActorLocation();
-	const FName baseName = BoneNames[0];
 	const EBoneSpaces::Type localSpace = EBoneSpaces::ComponentSpace;
 	const EBoneSpaces::Type worldSpace = EBoneSpaces::WorldSpace;
-	const FVector armBasePos = armMesh->GetBoneLocationByName(baseName, worldSpace);
-
-	const float armLength = FVector::Distance(
+	ik.base = armMesh->GetBoneLocationByName(BoneNames[0], worldSpace);
+	ik.origin = GetActorLocation();
+	ik.right = GetActorRightVector();
+	ik.segmentLength = FVector::Distance(
 		armMesh->GetBoneLocationByName(BoneNames[1], localSpace),
 		armMesh->GetBoneLocationByName(BoneNames[2], localSpace)
 	);
 
-	// Adjuste target to take arm effector offset into account
-	FVector offset = armMesh->GetBoneLocation(EffectorBoneName, worldSpace) - armMesh->GetBoneLocation(BoneNames[5], worldSpace);
-	FVector target = actualTarget;
-	target.Z += abs(offset.Z);
-	const float dist = FVector::Distance(
-		armBasePos,
-		target
-	);
+	// Adjust targets to take arm effector offset into account
+	const FVector offset = armMesh->GetBoneLocation(EffectorBoneName, worldSpace) - armMesh->GetBoneLocation(BoneNames[5], worldSpace);
+	ik.effectorHeight = abs(offset.Z);
+	return ik;
+}
+
+bool ARobotArm::AddPathNode(const FVector& target, const FRotator& orientation, GripAction gripAction) {
+	FRobotArmIKSolution solution;
+	GetIK().Solve(&target, 1, solution);
+	return AddPathNode(solution, 0, orientation, gripAction);
+}
 
+bool ARobotArm::AddPathNode(const FRobotArmIKSolution& solution, int32 index, const FRotator& orientation, GripAction gripAction) {
 	// Target cannot be reached
-	if (dist > 3 * armLength)
+	if (!solution.reachable[index])
 		return false;
 
-	// Compute angle to orient arm toward target
-	// Init vectors
-	FVector targetV = target - actorLocation;
-	targetV.Normalize();
-	const FVector rightV = GetActorRightVector();
-
-	// Compute angle in degrees
-	float angle = acos(targetV.CosineAngle2D(rightV)) * 180.f / PI;
-	if (FVector::CrossProduct(targetV, rightV).Z > 0)
-		angle = -angle;
-
+	float angle = solution.yaw[index];
 	float headOrientation = orientation.Yaw;
-	if (PathNodes.Num() > 0) {
-		const float lastBaseAngle = PathNodes[PathNodes.Num() - 1][0];
+	if (PathAngles.Num() > 0) {
+		const float lastBaseAngle = PathAngles[PathAngles.Num() - 6];
 		ShortestAngle(lastBaseAngle, angle);
 
-		const float lastHeadAngle = PathNodes[PathNodes.Num() - 1][5];
+		const float lastHeadAngle = PathAngles[PathAngles.Num() - 1];
 		ShortestAngle(lastHeadAngle, headOrientation);
 	}
-	FRotator baseRot = armMesh->GetBoneRotationByName(baseName, localSpace);
-	baseRot.Yaw = angle;
-	armMesh->SetBoneRotationByName(baseName, baseRot, localSpace);
-
-	// Compute joints angle
-	// Height difference
-	const float heightDiff = target.Z - armBasePos.Z;
-	float outerAngle = -atan(heightDiff / dist) * (180.f / PI);
-
-	// Inner and outer angles (of trapezoid)
-	float innerAngle;
-	const float term = (dist - armLength) / (-2 * armLength);
-	if (dist <= armLength)
-		innerAngle = acos(term);
-	else
-		innerAngle = asin(-term);
-	
-	innerAngle = (innerAngle * 180.f / PI) + 90.f;
-	outerAngle += 90.f - (180.f - innerAngle);
 
 	// Create node
-	const TArray<float> angles({
+	const float angles[6] = {
 		angle,
-		outerAngle,
-		outerAngle + 180 - innerAngle,
-		outerAngle + 2 * (180 - innerAngle),
+		solution.shoulder[index],
+		solution.elbow[index],
+		solution.wrist[index],
 		-90,
 		headOrientation
-	});
-	PathNodes.Add(angles);
+	};
+	PathAngles.Append(angles, 6);
 
+	// Show the arm on its last node while it is being set up
+	UPoseableMeshComponent* armMesh = Cast<UPoseableMeshComponent>(RootComponent);
+	const EBoneSpaces::Type localSpace = EBoneSpaces::ComponentSpace;
+	FRotator baseRot = armMesh->GetBoneRotationByName(BoneNames[0], localSpace);
+	baseRot.Yaw = angle;
+	armMesh->SetBoneRotationByName(BoneNames[0], baseRot, localSpace);
 	for (size_t i = 1; i < 6; ++i) {
 		FRotator rotation = armMesh->GetBoneRotationByName(BoneNames[i], localSpace);
 		rotation.SetComponentForAxis(BoneAxes[i], angles[i]);
@@ -240,40 +267,77 @@ bool ARobotArm::AddPathNode(const FVector& actualTarget, const FRotator &orienta
 }
 
 void ARobotArm::HandleProgress(float Value) {
-	const size_t stateCount = PathNodes.Num();
-	const float stateTime = 1.f / stateCount;
-	const float progress = Value / stateTime;
-	const size_t currentState = ((size_t)progress) % stateCount;
-	const size_t nextState = (currentState + 1) % stateCount;
-
-	const float interp = (progress - currentState);
-	UPoseableMeshComponent* arm = Cast<UPoseableMeshComponent>(RootComponent);
-
-	for (size_t i = 0; i < BoneNames.Num(); ++i) {
-		const float s0 = PathNodes[currentState][i];
-		const float s1 = PathNodes[nextState][i];
-		const float angle = s0 * (1 - interp) + s1 * interp;
-
-		FRotator rotation = arm->GetBoneRotationByName(BoneNames[i], EBoneSpaces::ComponentSpace);
-		rotation.SetComponentForAxis(BoneAxes[i], angle);
-		arm->SetBoneRotationByName(BoneNames[i], rotation, EBoneSpaces::ComponentSpace);
+	if (AnimationHandle >= 0)
+		Animation->SetProgress(AnimationHandle, Value);
+}
+
+void ARobotArm::SetSimulationTime(float time) {
+	HandleProgress(curve ? curve->GetFloatValue(time * CycleLength) : time);
+}
+
+void ARobotArm::HandleSimulationEvent(EFactoryEvent event) {
+	switch (event) {
+	case EFactoryEvent::ArmWaitPick:
+		HandleTryPick();
+		break;
+	case EFactoryEvent::ArmWaitDrop:
+		HandleTryDrop();
+		break;
+	case EFactoryEvent::ArmPick:
+		OnPick();
+		break;
+	case EFactoryEvent::ArmDrop:
+		OnDrop();
+		break;
+	default:
+		break;
 	}
 }
 
 void ARobotArm::HandleTryPick() {
+	PickedItemType = -1;
 	WaitPick = !ReadyToPick();
+	if (WaitPick)
+		WaitForMachine(Src);
+	else
+		ResumeSimulation(PickedItemType);
 }
 
 void ARobotArm::HandleTryDrop() {
 	WaitDrop = !ReadyToDrop();
+	if (WaitDrop)
+		WaitForMachine(Dst);
+	else
+		ResumeSimulation();
 }
 
-void ARobotArm::HandleTimelineEnd() {
-	/*
-	const float playbackPos = Timeline.GetPlaybackPosition();
-	if (playbackPos == curve->GetFloatValue(0))
-		Timeline.PlayFromStart();
-	else 
-		Timeline.ReverseFromEnd();
-	*/
-}
\ No newline at end of file
+void ARobotArm::WaitForMachine(AActor* machine) {
+	const UMachineSignalComponent* signals = UMachineSignalComponent::Find(machine);
+	const bool poll = !signals || !signals->bSignalsEveryWait;
+	if (poll && PolledMachine != machine) {
+		UE_LOG(LogTemp, Warning, TEXT("%s polls %s every tick while waiting, it does not signal every wait."),
+			*GetName(), *GetNameSafe(machine));
+		PolledMachine = machine;
+	}
+	SetActorTickEnabled(poll);
+}
+
+void ARobotArm::ResumeSimulation(int32 itemType) {
+	SetActorTickEnabled(false);
+	if (Factory && FactoryArm >= 0) {
+		const int32 arm = FactoryArm;
+		Factory->Access([arm, itemType](FFactorySimulation& simulation) {
+			simulation.ResumeArm(arm, itemType);
+		});
+	}
+}
+
+void ARobotArm::HandleItemAvailable(AActor* machine) {
+	if (WaitPick)
+		HandleTryPick();
+}
+
+void ARobotArm::HandleSlotFree(AActor* machine) {
+	if (WaitDrop)
+		HandleTryDrop();
+}
@@ -5,13 +5,16 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "MyCharacter.h"
-
-#include "Components/TimelineComponent.h"
+#include "RobotArmIK.h"
 
 #include "RobotArm.generated.h"
 
 
 class UCurveFloat;
+class ATerrain;
+class URobotArmSubsystem;
+class UFactorySubsystem;
+enum class EFactoryEvent : uint8;
 
 UENUM(BlueprintType)
 enum class Axe : uint8 {
@@ -33,6 +36,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	enum GripAction {
 		NOTHING,
@@ -43,8 +48,20 @@ private:
 	UFUNCTION()
 	void HandleProgress(float Value);
 
-	UFUNCTION()
-	void HandleTimelineEnd();
+	/**
+		Waits on the machine for its signal if it signals every wait. Polls
+		it on tick otherwise, warning once per machine since the arm then
+		costs a Blueprint call every frame.
+	 */
+	void WaitForMachine(AActor* machine);
+
+	// Machine is ready, lets the simulated arm go on, holding itemType
+	// after a pick (-1 if unknown)
+	void ResumeSimulation(int32 itemType = -1);
+
+	// Machine signals, wake the arm if it waits on them
+	void HandleItemAvailable(AActor* machine);
+	void HandleSlotFree(AActor* machine);
 
 	/**
 		Calculates end angle to minimize travel distance.
@@ -63,8 +80,14 @@ public:
 
 	virtual void OnSelect(AActor* selected) override;
 
+	// Factory simulation events of this arm
+	void HandleSimulationEvent(EFactoryEvent event);
+
+	// Position along the path cycle, in [0, 1)
+	void SetSimulationTime(float time);
+
 	/**
-		Callbacks for timeline events
+		Callbacks for simulation events
 	*/
 	UFUNCTION()
 	void HandleTryPick();
@@ -92,12 +115,22 @@ public:
 	 */
 	bool AddPathNode(const FVector& target, const FRotator& orientation, GripAction gripAction);
 
+	/**
+		Add a node to this arm path, from target index of a solved batch.
+	 */
+	bool AddPathNode(const FRobotArmIKSolution& solution, int32 index, const FRotator& orientation, GripAction gripAction);
+
+	/**
+		IK solver set up with the arm geometry where it stands.
+	 */
+	FRobotArmIK GetIK() const;
+
 	/**
 		Removes last added path node.
 	 */
 	void PopPathNode() {
-		if (PathNodes.Num() > 0)
-			PathNodes.Pop();
+		if (PathAngles.Num() > 0)
+			PathAngles.SetNum(PathAngles.Num() - 6);
 	}
 	/**
 		Put the arm in setup mode.
@@ -123,14 +156,39 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RobotArm")
 	AActor* Dst;
 
-	FTimeline Timeline;
+	// Type of the item ReadyToPick took from a Blueprint machine, set it
+	// before returning true so belts and inventories get the right item.
+	// Left at -1 the arm drops nothing onto them.
+	UPROPERTY(BlueprintReadWrite, Category = "RobotArm")
+	int32 PickedItemType;
+
+	// Cycles through the path in the factory simulation, curve maps the
+	// cycle time (over the curve time range) to path progress
+	UFactorySubsystem* Factory;
+	int32 FactoryArm;
+	float CycleLength;
+
+	// Keeps the chunk the arm stands in loaded while it works
+	ATerrain* Terrain;
+	int32 TerrainTicket;
+	int32 TerrainOccupant;
 
 	bool WaitDrop;
 	bool WaitPick;
+	// Last machine polling was warned about
+	TWeakObjectPtr<AActor> PolledMachine;
+
+	FDelegateHandle ItemAvailableHandle;
+	FDelegateHandle SlotFreeHandle;
 
 	TArray<int> BoneIndices;
 	TArray<FName> BoneNames;
 	EAxis::Type BoneAxes[6];
 
-	TArray< TArray<float> > PathNodes;
+	// Path node angles, one per bone, nodes one after another
+	TArray<float> PathAngles;
+
+	// Animates the arm once its path is complete
+	URobotArmSubsystem* Animation;
+	int32 AnimationHandle;
 };
@@ -0,0 +1,119 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RobotArmIK.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+
+#include <cmath>
+
+static FAutoConsoleCommand RobotArmIKBenchmarkCommand(
+	TEXT("RobotArm.BenchmarkIK"),
+	TEXT("Solves random arm targets in batches and one by one, and reports solves per second. Optional arguments: targets per batch (default 4096), batches (default 256)."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+		const int32 count = FMath::Max(args.Num() > 0 ? FCString::Atoi(*args[0]) : 4096, 1);
+		const int32 batches = FMath::Max(args.Num() > 1 ? FCString::Atoi(*args[1]) : 256, 1);
+
+		FRobotArmIK ik;
+		ik.base = FVector(0, 0, 50);
+		ik.origin = FVector::ZeroVector;
+		ik.right = FVector(0, 1, 0);
+		ik.segmentLength = 100;
+		ik.effectorHeight = 20;
+
+		FRandomStream random(42);
+		TArray<FVector> targets;
+		targets.SetNumUninitialized(count);
+		for (FVector& target : targets)
+			target = FVector(random.FRandRange(-350, 350), random.FRandRange(-350, 350), random.FRandRange(-100, 200));
+
+		FRobotArmIKSolution solution;
+		double start = FPlatformTime::Seconds();
+		for (int32 b = 0; b < batches; ++b)
+			ik.Solve(targets.GetData(), count, solution);
+		const double batched = FPlatformTime::Seconds() - start;
+
+		int32 reachable = 0;
+		for (bool r : solution.reachable)
+			reachable += r;
+
+		// One target per call, as arms used to solve their path
+		start = FPlatformTime::Seconds();
+		for (int32 b = 0; b < batches; ++b)
+			for (int32 i = 0; i < count; ++i)
+				ik.Solve(&targets[i], 1, solution);
+		const double single = FPlatformTime::Seconds() - start;
+
+		const double solves = static_cast<double>(count) * batches;
+		UE_LOG(LogTemp, Display, TEXT("Arm IK %d targets x %d batches (%d reachable): batched %.0f solves/s, one by one %.0f solves/s"),
+			count, batches, reachable, solves / batched, solves / single);
+	}));
+
+FRobotArmIK::FRobotArmIK() :
+	base(FVector::ZeroVector),
+	origin(FVector::ZeroVector),
+	right(FVector(0, 1, 0)),
+	segmentLength(100),
+	effectorHeight(0)
+{
+}
+
+void FRobotArmIK::Solve(const FVector* targets, int32 count, FRobotArmIKSolution& solution) const {
+	m_x.SetNumUninitialized(count, false);
+	m_y.SetNumUninitialized(count, false);
+	m_z.SetNumUninitialized(count, false);
+	m_distance.SetNumUninitialized(count, false);
+	solution.yaw.SetNumUninitialized(count, false);
+	solution.shoulder.SetNumUninitialized(count, false);
+	solution.elbow.SetNumUninitialized(count, false);
+	solution.wrist.SetNumUninitialized(count, false);
+	solution.reachable.SetNumUninitialized(count, false);
+
+	float* RESTRICT x = m_x.GetData();
+	float* RESTRICT y = m_y.GetData();
+	float* RESTRICT z = m_z.GetData();
+	float* RESTRICT distance = m_distance.GetData();
+	float* RESTRICT yaw = solution.yaw.GetData();
+	float* RESTRICT shoulder = solution.shoulder.GetData();
+	float* RESTRICT elbow = solution.elbow.GetData();
+	float* RESTRICT wrist = solution.wrist.GetData();
+	bool* RESTRICT reachable = solution.reachable.GetData();
+
+	const float toDegrees = 180.f / PI;
+	const float length = segmentLength;
+	const float reach = 3 * length;
+
+	// Targets relative to the base, effector offset included
+	for (int32 i = 0; i < count; ++i) {
+		x[i] = targets[i].X - base.X;
+		y[i] = targets[i].Y - base.Y;
+		z[i] = targets[i].Z + effectorHeight - base.Z;
+	}
+
+	for (int32 i = 0; i < count; ++i) {
+		distance[i] = std::sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i]);
+		reachable[i] = distance[i] <= reach;
+	}
+
+	// Signed angle from right to the target, seen from above the origin
+	const float baseX = base.X - origin.X;
+	const float baseY = base.Y - origin.Y;
+	for (int32 i = 0; i < count; ++i) {
+		const float tx = x[i] + baseX;
+		const float ty = y[i] + baseY;
+		yaw[i] = -std::atan2(tx * right.Y - ty * right.X, tx * right.X + ty * right.Y) * toDegrees;
+	}
+
+	// Trapezoid, folded inwards under one segment length, unfolding past it
+	for (int32 i = 0; i < count; ++i) {
+		const float d = FMath::Max(distance[i], KINDA_SMALL_NUMBER);
+		const float term = FMath::Clamp((d - length) / (-2 * length), -1.f, 1.f);
+		const float inner = (d <= length ? std::acos(term) : std::asin(-term)) * toDegrees + 90.f;
+		const float outer = -std::atan(z[i] / d) * toDegrees + inner - 90.f;
+
+		shoulder[i] = outer;
+		elbow[i] = outer + 180.f - inner;
+		wrist[i] = outer + 2 * (180.f - inner);
+	}
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+	Joint angles of a batch of targets, in degrees, one entry per target.
+*/
+struct FRobotArmIKSolution {
+	// Base rotation around Z, from the arm right vector
+	TArray<float> yaw;
+	// Shoulder, elbow and wrist of the trapezoid
+	TArray<float> shoulder;
+	TArray<float> elbow;
+	TArray<float> wrist;
+	// Targets out of reach still get angles, pointing the arm at them
+	TArray<bool> reachable;
+};
+
+/**
+	Analytic inverse kinematics of the robot arm: a base turning around Z
+	and three equal segments folded as an isosceles trapezoid towards the
+	target. Pure math on the arm geometry, components are never touched.
+
+	Targets are solved in batches, each step of the solve being a loop over
+	plain float arrays so the compiler can vectorise it across targets.
+ */
+class FRobotArmIK {
+public:
+	FRobotArmIK();
+
+	/*
+		Solves count targets, world space. Resizes solution to count.
+	*/
+	void Solve(const FVector* targets, int32 count, FRobotArmIKSolution& solution) const;
+
+	// World position of the base joint
+	FVector base;
+	// Yaw is measured around origin (the actor location), from right
+	FVector origin;
+	FVector right;
+	// Length of each of the three segments
+	float segmentLength;
+	// Height of the effector under the last joint, added to targets
+	float effectorHeight;
+
+private:
+	// Scratch arrays, one entry per target
+	mutable TArray<float> m_x;
+	mutable TArray<float> m_y;
+	mutable TArray<float> m_z;
+	mutable TArray<float> m_distance;
+};
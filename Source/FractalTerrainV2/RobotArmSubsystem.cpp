@@ -0,0 +1,225 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "RobotArmSubsystem.h"
+
+#include "Async/ParallelFor.h"
+#include "Components/PoseableMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
+
+URobotArmSubsystem::URobotArmSubsystem() :
+	FarDistance(5000.f),
+	FarInterval(0.1f),
+	HiddenInterval(0.25f),
+	m_activeArms(0),
+	m_garbage(0)
+{
+}
+
+void URobotArmSubsystem::Deinitialize() {
+	m_meshes.Empty();
+	m_progress.Empty();
+	m_timeToUpdate.Empty();
+	m_pathStart.Empty();
+	m_pathNodes.Empty();
+	m_pathAngles.Empty();
+	m_parentStart.Empty();
+	m_parentCount.Empty();
+	m_parents.Empty();
+	m_bones.Empty();
+	m_axes.Empty();
+	m_angles.Empty();
+	m_freeSlots.Empty();
+	m_activeArms = 0;
+	m_garbage = 0;
+
+	Super::Deinitialize();
+}
+
+int32 URobotArmSubsystem::RegisterArm(UPoseableMeshComponent* mesh, const TArray<int32>& bones, const EAxis::Type* axes, const TArray<float>& path) {
+	if (!mesh || !mesh->SkeletalMesh || bones.Num() != JointCount || path.Num() < JointCount || path.Num() % JointCount) {
+		UE_LOG(LogTemp, Warning, TEXT("Robot arm cannot be animated, needs %d bones and a path."), JointCount);
+		return -1;
+	}
+
+	// Pose is written in a single walk from the root
+	for (int32 i = 1; i < JointCount; ++i) {
+		if (bones[i] <= bones[i - 1]) {
+			UE_LOG(LogTemp, Warning, TEXT("Robot arm bones must go from root to tip."));
+			return -1;
+		}
+	}
+
+	const int32 boneCount = bones[JointCount - 1] + 1;
+	if (mesh->BoneSpaceTransforms.Num() < boneCount) {
+		UE_LOG(LogTemp, Warning, TEXT("Robot arm bones are not in its skeleton."));
+		return -1;
+	}
+
+	int32 arm;
+	if (m_freeSlots.Num() > 0)
+		arm = m_freeSlots.Pop();
+	else {
+		arm = m_meshes.Num();
+		m_meshes.AddZeroed();
+		m_progress.AddZeroed();
+		m_timeToUpdate.AddZeroed();
+		m_pathStart.AddZeroed();
+		m_pathNodes.AddZeroed();
+		m_parentStart.AddZeroed();
+		m_parentCount.AddZeroed();
+		m_bones.AddZeroed(JointCount);
+		m_axes.AddZeroed(JointCount);
+		m_angles.AddZeroed(JointCount);
+	}
+
+	m_meshes[arm] = mesh;
+	m_progress[arm] = 0;
+	m_timeToUpdate[arm] = 0;
+
+	m_pathStart[arm] = m_pathAngles.Num();
+	m_pathNodes[arm] = path.Num() / JointCount;
+	m_pathAngles.Append(path);
+
+	const FReferenceSkeleton& skeleton = mesh->SkeletalMesh->RefSkeleton;
+	m_parentStart[arm] = m_parents.Num();
+	m_parentCount[arm] = boneCount;
+	for (int32 bone = 0; bone < boneCount; ++bone)
+		m_parents.Add(skeleton.GetParentIndex(bone));
+
+	for (int32 i = 0; i < JointCount; ++i) {
+		m_bones[arm * JointCount + i] = bones[i];
+		m_axes[arm * JointCount + i] = static_cast<uint8>(axes[i]);
+		m_angles[arm * JointCount + i] = path[i];
+	}
+
+	++m_activeArms;
+	return arm;
+}
+
+void URobotArmSubsystem::UnregisterArm(int32 handle) {
+	if (!m_meshes.IsValidIndex(handle) || !m_meshes[handle])
+		return;
+
+	m_garbage += m_pathNodes[handle] * JointCount + m_parentCount[handle];
+	m_meshes[handle] = nullptr;
+	m_pathNodes[handle] = 0;
+	m_pathStart[handle] = 0;
+	m_parentCount[handle] = 0;
+	m_parentStart[handle] = 0;
+	m_freeSlots.Add(handle);
+	--m_activeArms;
+
+	if (m_garbage > (m_pathAngles.Num() + m_parents.Num()) / 2)
+		compact();
+}
+
+void URobotArmSubsystem::compact() {
+	TArray<float> pathAngles;
+	TArray<int32> parents;
+	pathAngles.Reserve(m_pathAngles.Num() - m_garbage);
+	parents.Reserve(m_parents.Num());
+
+	for (int32 arm = 0; arm < m_meshes.Num(); ++arm) {
+		// Free slots own nothing, their starts may lie past the arrays end
+		if (m_pathNodes[arm] == 0) {
+			m_pathStart[arm] = 0;
+			m_parentStart[arm] = 0;
+			continue;
+		}
+
+		const int32 pathStart = pathAngles.Num();
+		pathAngles.Append(m_pathAngles.GetData() + m_pathStart[arm], m_pathNodes[arm] * JointCount);
+		m_pathStart[arm] = pathStart;
+
+		const int32 parentStart = parents.Num();
+		parents.Append(m_parents.GetData() + m_parentStart[arm], m_parentCount[arm]);
+		m_parentStart[arm] = parentStart;
+	}
+
+	m_pathAngles = MoveTemp(pathAngles);
+	m_parents = MoveTemp(parents);
+	m_garbage = 0;
+}
+
+void URobotArmSubsystem::Tick(float DeltaTime) {
+	UWorld* world = GetGameInstance()->GetWorld();
+	APlayerCameraManager* camera = world ? UGameplayStatics::GetPlayerCameraManager(world, 0) : nullptr;
+	const FVector cameraLocation = camera ? camera->GetCameraLocation() : FVector::ZeroVector;
+	const float farDistanceSquared = FarDistance * FarDistance;
+
+	// Arms due this frame, rate picked from how visible they are
+	TArray<int32, TInlineAllocator<256>> due;
+	for (int32 arm = 0; arm < m_meshes.Num(); ++arm) {
+		UPoseableMeshComponent* mesh = m_meshes[arm];
+		if (!mesh)
+			continue;
+
+		m_timeToUpdate[arm] -= DeltaTime;
+		if (m_timeToUpdate[arm] > 0)
+			continue;
+
+		if (!mesh->WasRecentlyRendered(0.2f))
+			m_timeToUpdate[arm] = HiddenInterval;
+		else if (camera && FVector::DistSquared(mesh->GetComponentLocation(), cameraLocation) > farDistanceSquared)
+			m_timeToUpdate[arm] = FarInterval;
+		else
+			m_timeToUpdate[arm] = 0;
+		due.Add(arm);
+	}
+
+	ParallelFor(due.Num(), [this, &due](int32 i) {
+		updateArm(due[i]);
+	});
+
+	for (int32 arm : due)
+		m_meshes[arm]->MarkRefreshTransformDirty();
+}
+
+void URobotArmSubsystem::updateArm(int32 arm) {
+	const int32 nodes = m_pathNodes[arm];
+	const float* path = &m_pathAngles[m_pathStart[arm]];
+	const float progress = m_progress[arm] * nodes;
+	const float interp = progress - FMath::FloorToFloat(progress);
+	const int32 current = FMath::FloorToInt(progress) % nodes;
+	const int32 next = (current + 1) % nodes;
+
+	float* angles = &m_angles[arm * JointCount];
+	for (int32 i = 0; i < JointCount; ++i)
+		angles[i] = FMath::Lerp(path[current * JointCount + i], path[next * JointCount + i], interp);
+
+	// Rotations are set around component space axes, bones in between keep
+	// their local transform
+	TArray<FTransform>& local = m_meshes[arm]->BoneSpaceTransforms;
+	const int32* parents = &m_parents[m_parentStart[arm]];
+	const int32* bones = &m_bones[arm * JointCount];
+	const uint8* axes = &m_axes[arm * JointCount];
+
+	TArray<FTransform, TInlineAllocator<32>> component;
+	component.SetNumUninitialized(m_parentCount[arm]);
+
+	int32 joint = 0;
+	for (int32 bone = 0; bone < m_parentCount[arm]; ++bone) {
+		const int32 parent = parents[bone];
+		component[bone] = parent >= 0 ? local[bone] * component[parent] : local[bone];
+		if (bones[joint] != bone)
+			continue;
+
+		FRotator rotation = component[bone].Rotator();
+		rotation.SetComponentForAxis(static_cast<EAxis::Type>(axes[joint]), angles[joint]);
+		component[bone].SetRotation(rotation.Quaternion());
+		local[bone] = parent >= 0 ? component[bone].GetRelativeTransform(component[parent]) : component[bone];
+		++joint;
+	}
+}
+
+bool URobotArmSubsystem::IsTickable() const {
+	return m_activeArms > 0;
+}
+
+TStatId URobotArmSubsystem::GetStatId() const {
+	RETURN_QUICK_DECLARE_CYCLE_STAT(URobotArmSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/GameInstanceSubsystem.h"
+#include "Tickable.h"
+#include "RobotArmSubsystem.generated.h"
+
+class UPoseableMeshComponent;
+
+/**
+	Animates every robot arm in one pass. Joint angles and path keyframes of
+	all arms live in flat arrays, arms are interpolated in parallel and
+	poses are written straight to the bone space transforms through bone
+	indices resolved at registration.
+	Arms off screen or far from the camera update at a lower rate.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API URobotArmSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static const int32 JointCount = 6;
+
+	URobotArmSubsystem();
+
+	virtual void Deinitialize() override;
+
+	/*
+		Starts animating mesh along path, JointCount angles per keyframe.
+		bones are the JointCount animated bone indices, root to tip, each
+		rotated around its axis in component space.
+		Returns a handle for the other calls, -1 if the arm cannot be animated.
+	*/
+	int32 RegisterArm(UPoseableMeshComponent* mesh, const TArray<int32>& bones, const EAxis::Type* axes, const TArray<float>& path);
+
+	void UnregisterArm(int32 handle);
+
+	// Position along the looping path, in [0, 1]
+	void SetProgress(int32 handle, float progress) {
+		m_progress[handle] = progress;
+	}
+
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+
+	// Arms further from the camera update every FarInterval seconds
+	float FarDistance;
+	float FarInterval;
+	// Arms not rendered recently update every HiddenInterval seconds
+	float HiddenInterval;
+
+private:
+	/*
+		Interpolates the arm angles and writes its bone space transforms.
+		Only touches data of this arm, safe to run in parallel.
+	*/
+	void updateArm(int32 arm);
+
+	// Rebuilds the path and parent arrays without freed slots
+	void compact();
+
+	// Per arm slot, null mesh for free slots
+	UPROPERTY()
+	TArray<UPoseableMeshComponent*> m_meshes;
+	TArray<float> m_progress;
+	TArray<float> m_timeToUpdate;
+
+	// Keyframes, JointCount angles each
+	TArray<int32> m_pathStart;
+	TArray<int32> m_pathNodes;
+	TArray<float> m_pathAngles;
+
+	// Skeleton parents up to the last animated bone
+	TArray<int32> m_parentStart;
+	TArray<int32> m_parentCount;
+	TArray<int32> m_parents;
+
+	// JointCount per arm
+	TArray<int32> m_bones;
+	TArray<uint8> m_axes;
+	TArray<float> m_angles;
+
+	TArray<int32> m_freeSlots;
+	int32 m_activeArms;
+	int32 m_garbage;
+};
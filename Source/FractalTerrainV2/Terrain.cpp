@@ -8,16 +8,88 @@
 #include "ProceduralMeshComponent.h"
 #include "Materials/MaterialInterface.h"
 #include "Kismet/GameplayStatics.h"
+#include "Camera/PlayerCameraManager.h"
+#include "VoxelChunkComponent.h"
+#include "TerrainCore/TerrainBenchmark.h"
 #include "Engine/EngineTypes.h"
+#include "HAL/IConsoleManager.h"
+#include "EngineUtils.h"
 #include "Math/BigInt.h"
 
 #include "DrawDebugHelpers.h"
 
 #include <cmath>
 
+DECLARE_STATS_GROUP(TEXT("Terrain"), STATGROUP_Terrain, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT(TEXT("Tick"), STAT_TerrainTick, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Generate chunk"), STAT_TerrainGenerateChunk, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Preload chunk"), STAT_TerrainPreloadChunk, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Load chunk"), STAT_TerrainLoadChunk, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Process chunk"), STAT_TerrainProcessChunk, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("CreateMeshSection"), STAT_TerrainCreateMeshSection, STATGROUP_Terrain);
+// Merged boxes, or mesh sections with triangle collision (within CreateMeshSection)
+DECLARE_CYCLE_STAT(TEXT("Collision"), STAT_TerrainCollision, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Visibility"), STAT_TerrainVisibility, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("Raycast"), STAT_TerrainRaycast, STATGROUP_Terrain);
+DECLARE_CYCLE_STAT(TEXT("PopBlock"), STAT_TerrainPopBlock, STATGROUP_Terrain);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Chunks loaded"), STAT_TerrainChunksLoaded, STATGROUP_Terrain);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Resident chunks"), STAT_TerrainResidentChunks, STATGROUP_Terrain);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Pending loads"), STAT_TerrainPendingLoads, STATGROUP_Terrain);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Dirty chunks"), STAT_TerrainDirtyChunks, STATGROUP_Terrain);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Vertices"), STAT_TerrainVertices, STATGROUP_Terrain);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Triangles"), STAT_TerrainTriangles, STATGROUP_Terrain);
+DECLARE_MEMORY_STAT(TEXT("Grid memory"), STAT_TerrainGridMemory, STATGROUP_Terrain);
+
+const int32 ATerrain::NoSurface;
+
+// Hitch dumps closer than this are skipped, a freeze often spans frames
+static const double MinHitchDumpInterval = 10.0;
+
+static FAutoConsoleCommandWithWorld DumpFlightRecorderCommand(
+	TEXT("Terrain.DumpFlightRecorder"),
+	TEXT("Writes the terrain flight recorder of the last frames to Saved/TerrainHitches."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* world) {
+		for (TActorIterator<ATerrain> it(world); it; ++it) {
+			const FString path = it->DumpFlightRecorder(TEXT("Console"));
+			UE_LOG(LogTemp, Display, TEXT("Terrain flight recorder written to %s"), *path);
+		}
+	}));
+
+static FAutoConsoleCommand TerrainBenchmarkCommand(
+	TEXT("Terrain.Benchmark"),
+	TEXT("Benchmarks the terrain core for chunk sizes 16, 32 and 64, specialised and runtime sized kernels. Optional arguments: chunks (default 16), raycasts (default 10000)."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& args) {
+		const int32 chunks = args.Num() > 0 ? FCString::Atoi(*args[0]) : 16;
+		const int32 raycasts = args.Num() > 1 ? FCString::Atoi(*args[1]) : 10000;
+		const int32 sizes[3] = { 16, 32, 64 };
+		for (const int32 size : sizes) {
+			const TerrainCore::ChunkKernels* kernels[2] = { TerrainCore::SelectChunkKernels(size), &TerrainCore::RuntimeChunkKernels() };
+			for (size_t i = 0; i < 2; ++i) {
+				const TerrainCore::BenchmarkResult result = TerrainCore::RunBenchmark(*kernels[i], size, chunks, raycasts);
+				UE_LOG(LogTemp, Display, TEXT("Terrain %s %d: %.1f chunks generated/s, %.1f chunks meshed/s, %.0f triangles/chunk, %.3f bytes/voxel, %.0f raycasts/s"),
+					i == 0 ? TEXT("specialised") : TEXT("runtime"), size,
+					result.chunksGeneratedPerSecond, result.chunksMeshedPerSecond,
+					result.trianglesPerChunk, result.bytesPerVoxel, result.raycastsPerSecond);
+			}
+		}
+	}));
+
+// Chunk offsets in face order: -X, +X, -Y, +Y, -Z, +Z
+static const int32 ChunkNeighbours[6][3] = {
+	{ -1, 0, 0 },
+	{ 1, 0, 0 },
+	{ 0, -1, 0 },
+	{ 0, 1, 0 },
+	{ 0, 0, -1 },
+	{ 0, 0, 1 }
+};
+
 static void AddFace(
 	size_t dir,
-	const openvdb::Coord::Int32 *coordPtr,
+	const int32 *coordPtr,
+	int32 size,
 	TArray<FVector> &vertices,
 	TArray<int32> &triangles,
 	TArray<FVector> &normals) {
@@ -45,13 +117,13 @@ static void AddFace(
 	const int32_t z = coordPtr[2];
 	const FVector vertexList[8] = {
 		FVector(x, y, z),
-		FVector(x, y, z + 1),
-		FVector(x, y + 1, z),
-		FVector(x, y + 1, z + 1),
-		FVector(x + 1, y, z),
-		FVector(x + 1, y, z + 1),
-		FVector(x + 1, y + 1, z),
-		FVector(x + 1, y + 1, z + 1)
+		FVector(x, y, z + size),
+		FVector(x, y + size, z),
+		FVector(x, y + size, z + size),
+		FVector(x + size, y, z),
+		FVector(x + size, y, z + size),
+		FVector(x + size, y + size, z),
+		FVector(x + size, y + size, z + size)
 	};
 
 	const size_t faceVertices[6][4] = {
@@ -80,54 +152,61 @@ ATerrain::ATerrain(){
 	VoxelSize = 100;
 	ChunkSize = 32;
 	DbgChunkLoadRange = 3;
+	MaxChunkLoadsPerTick = 4;
+	FlightRecorderFrames = 300;
+	HitchThresholdMs = 100.f;
+	m_lastHitchDump = -MinHitchDumpInterval;
+	LodRanges = { 1, 2, 4 };
+	m_nextTicket = 0;
+	m_nextOccupant = 0;
+	m_lodsDirty = false;
+	bCullHiddenChunks = true;
+	m_visibilityDirty = false;
+	m_visibilityReady = false;
 	m_chunkWorldSize = ChunkSize * VoxelSize;
+	m_kernels = TerrainCore::SelectChunkKernels(ChunkSize);
+	m_chunkShift = FMath::IsPowerOfTwo(ChunkSize) ? FMath::FloorLog2(ChunkSize) : -1;
 
 	openvdb::initialize();
 	m_grid = openvdb::FloatGrid::create();
+	m_readAccessor = MakeUnique<openvdb::FloatGrid::ConstAccessor>(m_grid->getConstAccessor());
 
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Terrain"));
 
-	const int size = static_cast<int>(ChunkSize);
-	m_heightMapBuilder.SetSourceModule(m_groundNoiseModule);
-	m_heightMapBuilder.SetDestNoiseMap(m_heightMap);
-	m_heightMapBuilder.SetDestSize(1 + size * 2, 1 + size * 2);
-
+	bSingleMeshSection = false;
+	bPackedChunkMesh = false;
+	m_packedMesh = false;
+	m_totalVertices = 0;
+	m_totalTriangles = 0;
+	m_gridMemoryDirty = true;
 	GroundMaterial = nullptr;
 	CoalOreMaterial = nullptr;
+	CollisionMode = ETerrainCollisionMode::Mesh;
 	HeightFactor = 20.0;
 }
 
 bool ATerrain::Raycast(const FVector& start, const FVector& end, FIntVector& blockCoords, FVector &impactCoords) {
-	bool found = false;
-	struct FHitResult hitResult;
-	//TODO: Fix this, as intersection may not be the closest
-	for (auto& entry : m_chunks) {
-		UProceduralMeshComponent* mesh = entry.Value;
-		struct FHitResult tempHitRes;
-		if (mesh->LineTraceComponent(tempHitRes, start, end, FCollisionQueryParams::DefaultQueryParam)) {
-			if (!found || tempHitRes.Distance < hitResult.Distance) {
-				found = true;
-				hitResult = tempHitRes;
-				continue;
-			}
-		}
-	}
-	if (found) {
-		impactCoords.X = hitResult.ImpactPoint.X;
-		impactCoords.Y = hitResult.ImpactPoint.Y;
-		impactCoords.Z = hitResult.ImpactPoint.Z;
-		const FVector impact = hitResult.ImpactPoint / VoxelSize;
-		blockCoords.X = std::floor(impact.X);
-		blockCoords.Y = std::floor(impact.Y);
-		blockCoords.Z = std::floor(impact.Z);
-		if (hitResult.Normal.X > 0) --blockCoords.X;
-		else if (hitResult.Normal.Y > 0) --blockCoords.Y;
-		else if (hitResult.Normal.Z > 0) --blockCoords.Z;
-	}
-	return found;
+	SCOPE_CYCLE_COUNTER(STAT_TerrainRaycast);
+
+	// Voxel traversal on the grid, so hits do not depend on chunk collision
+	// being cooked yet
+	const FVector origin = start / VoxelSize;
+	const FVector dir = (end - start) / VoxelSize;
+	const float o[3] = { origin.X, origin.Y, origin.Z };
+	const float d[3] = { dir.X, dir.Y, dir.Z };
+
+	int32 voxel[3];
+	float t;
+	if (!TerrainCore::RaycastGrid(*m_readAccessor, o, d, voxel, t))
+		return false;
+
+	blockCoords = FIntVector(voxel[0], voxel[1], voxel[2]);
+	impactCoords = start + (end - start) * t;
+	return true;
 }
 
 float ATerrain::PopBlock(const FIntVector& coord) {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainPopBlock);
 	openvdb::Coord voxel(coord.X, coord.Y, coord.Z);
 
 	// Draw debug block
@@ -141,115 +220,848 @@ float ATerrain::PopBlock(const FIntVector& coord) {
 	openvdb::FloatGrid::Accessor accessor = m_grid->getAccessor();
 	const float voxelType = accessor.getValue(voxel);
 	accessor.setValue(voxel, 1);
+	gridChanged();
 
-	openvdb::Coord voxels[6] = {
-		voxel.offsetBy(0, 0, -1),
-		voxel.offsetBy(0, 0,  1),
-		voxel.offsetBy(0, -1, 0),
-		voxel.offsetBy(0,  1, 0),
-		voxel.offsetBy(1, 0, 0),
-		voxel.offsetBy(-1, 0, 0),
-	};
-
-	const int64 chunkId = getChunkIndex(
-		std::floor(coord.X / ChunkSize),
-		std::floor(coord.Y / ChunkSize),
-		std::floor(coord.Z / ChunkSize));
-
-	if (coord.X % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize) - 1,
-			std::floor(coord.Y / ChunkSize),
-			std::floor(coord.Z / ChunkSize)));
-	} else if ((coord.X + 1) % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize) + 1,
-			std::floor(coord.Y / ChunkSize),
-			std::floor(coord.Z / ChunkSize)));
-	}
-	if (coord.Y % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize),
-			std::floor(coord.Y / ChunkSize) - 1,
-			std::floor(coord.Z / ChunkSize)));
-	} else if ((coord.Y + 1) % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize),
-			std::floor(coord.Y / ChunkSize) + 1,
-			std::floor(coord.Z / ChunkSize)));
-	}
-	if (coord.Z % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize),
-			std::floor(coord.Y / ChunkSize),
-			std::floor(coord.Z / ChunkSize) - 1));
-	} else if ((coord.Z + 1) % ChunkSize == 0) {
-		m_dirtyChunks.Add(getChunkIndex(
-			std::floor(coord.X / ChunkSize),
-			std::floor(coord.Y / ChunkSize),
-			std::floor(coord.Z / ChunkSize) + 1));
-	}
-
-	m_dirtyChunks.Add(chunkId);
+	removeFromSurface(coord.X, coord.Y, coord.Z, coord.Z);
+	markVoxelDirty(coord);
 
 	//UE_LOG(LogTemp, Warning, TEXT("POPPED %f"), voxelType);
 	return voxelType;
 }
 
-int ATerrain::GetBlockType(const FIntVector& coord) {
+float ATerrain::PlaceBlock(const FIntVector& coord, int type) {
 	openvdb::Coord voxel(coord.X, coord.Y, coord.Z);
+
 	openvdb::FloatGrid::Accessor accessor = m_grid->getAccessor();
-	return (int)accessor.getValue(voxel);
+	const float voxelType = accessor.getValue(voxel);
+	if (type > 1) {
+		accessor.setValue(voxel, type);
+		gridChanged();
+		addToSurface(coord.X, coord.Y, coord.Z);
+	} else {
+		accessor.setValueOff(voxel, 1);
+		gridChanged();
+		removeFromSurface(coord.X, coord.Y, coord.Z, coord.Z);
+	}
+
+	markVoxelDirty(coord);
+	return voxelType;
+}
+
+TMap<int32, int32> ATerrain::CarveBox(const FIntVector& min, const FIntVector& max) {
+	return editBox(min, max, 1);
+}
+
+TMap<int32, int32> ATerrain::CarveSphere(const FIntVector& center, int32 radius) {
+	return editSphere(center, radius, 1);
+}
+
+TMap<int32, int32> ATerrain::CarveColumn(const FIntVector& top, int32 depth) {
+	if (depth < 1)
+		return TMap<int32, int32>();
+	return editBox(top - FIntVector(0, 0, depth - 1), top, 1);
+}
+
+TMap<int32, int32> ATerrain::FillBox(const FIntVector& min, const FIntVector& max, int32 type) {
+	return editBox(min, max, type);
+}
+
+TMap<int32, int32> ATerrain::FillSphere(const FIntVector& center, int32 radius, int32 type) {
+	return editSphere(center, radius, type);
+}
+
+TMap<int32, int32> ATerrain::FillColumn(const FIntVector& top, int32 depth, int32 type) {
+	if (depth < 1)
+		return TMap<int32, int32>();
+	return editBox(top - FIntVector(0, 0, depth - 1), top, type);
+}
+
+TMap<int32, int32> ATerrain::CountMaterials(const FIntVector& min, const FIntVector& max) {
+	TMap<int32, int32> histogram;
+	const openvdb::CoordBBox bbox(
+		openvdb::Coord(FMath::Min(min.X, max.X), FMath::Min(min.Y, max.Y), FMath::Min(min.Z, max.Z)),
+		openvdb::Coord(FMath::Max(min.X, max.X), FMath::Max(min.Y, max.Y), FMath::Max(min.Z, max.Z)));
+
+	generateRegion(bbox);
+	countMaterials(bbox, histogram);
+	return histogram;
+}
+
+TMap<int32, int32> ATerrain::editBox(const FIntVector& min, const FIntVector& max, int32 type) {
+	TMap<int32, int32> removed;
+	const openvdb::CoordBBox bbox(
+		openvdb::Coord(FMath::Min(min.X, max.X), FMath::Min(min.Y, max.Y), FMath::Min(min.Z, max.Z)),
+		openvdb::Coord(FMath::Max(min.X, max.X), FMath::Max(min.Y, max.Y), FMath::Max(min.Z, max.Z)));
+
+	generateRegion(bbox);
+	editSpan(bbox, type, removed);
+	markRegionDirty(bbox);
+	return removed;
+}
+
+TMap<int32, int32> ATerrain::editSphere(const FIntVector& center, int32 radius, int32 type) {
+	TMap<int32, int32> removed;
+	if (radius < 0)
+		return removed;
+
+	const openvdb::Coord c(center.X, center.Y, center.Z);
+	const openvdb::CoordBBox bbox(c.offsetBy(-radius), c.offsetBy(radius));
+	generateRegion(bbox);
+
+	// One fill per row span of the sphere
+	const int32 radiusSq = radius * radius;
+	for (int32 dz = -radius; dz <= radius; ++dz) {
+		for (int32 dy = -radius; dy <= radius; ++dy) {
+			const int32 remaining = radiusSq - dy * dy - dz * dz;
+			if (remaining < 0)
+				continue;
+			const int32 dx = FMath::FloorToInt(FMath::Sqrt(static_cast<float>(remaining)));
+			const openvdb::CoordBBox span(
+				c.offsetBy(-dx, dy, dz),
+				c.offsetBy(dx, dy, dz));
+			editSpan(span, type, removed);
+		}
+	}
+
+	markRegionDirty(bbox);
+	return removed;
+}
+
+void ATerrain::editSpan(const openvdb::CoordBBox& bbox, int32 type, TMap<int32, int32>& removed) {
+	countMaterials(bbox, removed);
+
+	// Fill replaces whole nodes by tiles when the box covers them
+	if (type > 1)
+		m_grid->fill(bbox, static_cast<float>(type), true);
+	else
+		m_grid->fill(bbox, 1.0, false);
+	gridChanged();
+
+	const openvdb::Coord& lo = bbox.min();
+	const openvdb::Coord& hi = bbox.max();
+	for (int32 x = lo.x(); x <= hi.x(); ++x) {
+		for (int32 y = lo.y(); y <= hi.y(); ++y) {
+			if (type > 1)
+				addToSurface(x, y, hi.z());
+			else
+				removeFromSurface(x, y, lo.z(), hi.z());
+		}
+	}
+}
+
+void ATerrain::countMaterials(const openvdb::CoordBBox& bbox, TMap<int32, int32>& histogram) const {
+	using LeafType = openvdb::FloatTree::LeafNodeType;
+	const openvdb::Int32 dim = LeafType::DIM;
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	const openvdb::Coord start = bbox.min() & ~(dim - 1);
+
+	// Walk leaf sized blocks, blocks without a leaf hold a single tile value
+	for (openvdb::Int32 x = start.x(); x <= bbox.max().x(); x += dim) {
+		for (openvdb::Int32 y = start.y(); y <= bbox.max().y(); y += dim) {
+			for (openvdb::Int32 z = start.z(); z <= bbox.max().z(); z += dim) {
+				const openvdb::Coord origin(x, y, z);
+				openvdb::CoordBBox overlap = openvdb::CoordBBox::createCube(origin, dim);
+				overlap.intersect(bbox);
+
+				if (const LeafType* leaf = accessor.probeConstLeaf(origin)) {
+					for (openvdb::CoordBBox::ZYXIterator it = overlap.beginZYX(); it; ++it) {
+						const int32 value = static_cast<int32>(leaf->getValue(*it));
+						if (value > 1)
+							++histogram.FindOrAdd(value);
+					}
+				} else {
+					const int32 value = static_cast<int32>(accessor.getValue(origin));
+					if (value > 1)
+						histogram.FindOrAdd(value) += static_cast<int32>(overlap.volume());
+				}
+			}
+		}
+	}
+}
+
+void ATerrain::generateRegion(const openvdb::CoordBBox& bbox) {
+	const openvdb::Coord& lo = bbox.min();
+	const openvdb::Coord& hi = bbox.max();
+	const FIntVector minChunk = voxelToChunkCoords(FIntVector(lo.x(), lo.y(), lo.z()));
+	const FIntVector maxChunk = voxelToChunkCoords(FIntVector(hi.x(), hi.y(), hi.z()));
+
+	// Edits must land after generation, or generation would overwrite them
+	for (int32 i = minChunk.X; i <= maxChunk.X; ++i)
+		for (int32 j = minChunk.Y; j <= maxChunk.Y; ++j)
+			for (int32 k = minChunk.Z; k <= maxChunk.Z; ++k)
+				generateChunk(getChunkIndex(i, j, k));
+}
+
+void ATerrain::markRegionDirty(const openvdb::CoordBBox& bbox) {
+	// Grow by one voxel so neighbours sharing a border face get remeshed
+	const openvdb::Coord& lo = bbox.min();
+	const openvdb::Coord& hi = bbox.max();
+	const FIntVector minChunk = voxelToChunkCoords(FIntVector(lo.x() - 1, lo.y() - 1, lo.z() - 1));
+	const FIntVector maxChunk = voxelToChunkCoords(FIntVector(hi.x() + 1, hi.y() + 1, hi.z() + 1));
+
+	for (int32 i = minChunk.X; i <= maxChunk.X; ++i)
+		for (int32 j = minChunk.Y; j <= maxChunk.Y; ++j)
+			for (int32 k = minChunk.Z; k <= maxChunk.Z; ++k)
+				m_dirtyChunks.AddUnique(getChunkIndex(i, j, k));
+}
+
+bool ATerrain::GetSurfaceHeight(int32 x, int32 y, int32& height) const {
+	const int32 size = static_cast<int32>(ChunkSize);
+	const FIntVector chunk = voxelToChunkCoords(FIntVector(x, y, 0));
+	const SurfaceColumn* column = m_surface.Find(getChunkIndex(chunk.X, chunk.Y, 0));
+	if (!column)
+		return false;
+
+	height = column->heights[(x - chunk.X * size) + (y - chunk.Y * size) * size];
+	return height != NoSurface;
+}
+
+bool ATerrain::RaycastSurface(const FVector& start, const FVector& end, FIntVector& blockCoords) const {
+	// Walk the columns crossed by the ray (2D DDA), in voxel units
+	const FVector origin = start / VoxelSize;
+	const FVector dir = (end - start) / VoxelSize;
+
+	int32 x = FMath::FloorToInt(origin.X);
+	int32 y = FMath::FloorToInt(origin.Y);
+	const int32 stepX = dir.X > 0 ? 1 : -1;
+	const int32 stepY = dir.Y > 0 ? 1 : -1;
+	const float tDeltaX = dir.X != 0 ? FMath::Abs(1.f / dir.X) : BIG_NUMBER;
+	const float tDeltaY = dir.Y != 0 ? FMath::Abs(1.f / dir.Y) : BIG_NUMBER;
+	float tMaxX = dir.X != 0 ? (stepX > 0 ? x + 1 - origin.X : origin.X - x) * tDeltaX : BIG_NUMBER;
+	float tMaxY = dir.Y != 0 ? (stepY > 0 ? y + 1 - origin.Y : origin.Y - y) * tDeltaY : BIG_NUMBER;
+
+	float t = 0;
+	while (true) {
+		int32 height;
+		if (!GetSurfaceHeight(x, y, height))
+			return false;
+
+		const float tExit = FMath::Min3(tMaxX, tMaxY, 1.f);
+		const float zEnter = origin.Z + dir.Z * t;
+		const float zExit = origin.Z + dir.Z * tExit;
+		const float top = height + 1;
+
+		// Starting under the surface (caves, tunnels), heightfield cannot answer
+		if (t == 0 && zEnter < top)
+			return false;
+
+		if (FMath::Min(zEnter, zExit) <= top) {
+			blockCoords = FIntVector(x, y, height);
+			return true;
+		}
+
+		if (tExit >= 1.f)
+			return false;
+
+		if (tMaxX < tMaxY) {
+			x += stepX;
+			t = tMaxX;
+			tMaxX += tDeltaX;
+		} else {
+			y += stepY;
+			t = tMaxY;
+			tMaxY += tDeltaY;
+		}
+	}
+}
+
+ATerrain::SurfaceColumn& ATerrain::getSurfaceColumn(const FIntVector& chunkCoords) {
+	SurfaceColumn* column = m_surface.Find(getChunkIndex(chunkCoords.X, chunkCoords.Y, 0));
+	if (column) {
+		column->minChunkZ = FMath::Min(column->minChunkZ, chunkCoords.Z);
+		return *column;
+	}
+
+	SurfaceColumn& created = m_surface.Add(getChunkIndex(chunkCoords.X, chunkCoords.Y, 0));
+	created.heights.Init(NoSurface, ChunkSize * ChunkSize);
+	created.minChunkZ = chunkCoords.Z;
+	return created;
+}
+
+void ATerrain::addToSurface(int32 x, int32 y, int32 top) {
+	const int32 size = static_cast<int32>(ChunkSize);
+	const FIntVector chunk = voxelToChunkCoords(FIntVector(x, y, top));
+	SurfaceColumn& column = getSurfaceColumn(chunk);
+	int32& height = column.heights[(x - chunk.X * size) + (y - chunk.Y * size) * size];
+	height = FMath::Max(height, top);
+}
+
+void ATerrain::removeFromSurface(int32 x, int32 y, int32 bottom, int32 top) {
+	const int32 size = static_cast<int32>(ChunkSize);
+	const FIntVector chunk = voxelToChunkCoords(FIntVector(x, y, 0));
+	SurfaceColumn* column = m_surface.Find(getChunkIndex(chunk.X, chunk.Y, 0));
+	if (!column)
+		return;
+
+	int32& height = column->heights[(x - chunk.X * size) + (y - chunk.Y * size) * size];
+	if (height < bottom || height > top)
+		return;
+
+	// Top voxel removed, look for the next solid one down to the lowest generated chunk
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	const int32 lowest = column->minChunkZ * size;
+	height = NoSurface;
+	for (int32 z = bottom - 1; z >= lowest; --z) {
+		if (accessor.getValue(openvdb::Coord(x, y, z)) > 1) {
+			height = z;
+			break;
+		}
+	}
+}
+
+void ATerrain::markVoxelDirty(const FIntVector& coord) {
+	const int32 size = static_cast<int32>(ChunkSize);
+	const FIntVector chunk = voxelToChunkCoords(coord);
+	const FIntVector local = m_chunkShift >= 0
+		? FIntVector(coord.X & (size - 1), coord.Y & (size - 1), coord.Z & (size - 1))
+		: coord - chunk * size;
+
+	// Voxels on a chunk border also change the neighbour mesh
+	if (local.X == 0)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X - 1, chunk.Y, chunk.Z));
+	else if (local.X == size - 1)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X + 1, chunk.Y, chunk.Z));
+	if (local.Y == 0)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X, chunk.Y - 1, chunk.Z));
+	else if (local.Y == size - 1)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X, chunk.Y + 1, chunk.Z));
+	if (local.Z == 0)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X, chunk.Y, chunk.Z - 1));
+	else if (local.Z == size - 1)
+		m_dirtyChunks.AddUnique(getChunkIndex(chunk.X, chunk.Y, chunk.Z + 1));
+
+	m_dirtyChunks.AddUnique(getChunkIndex(chunk.X, chunk.Y, chunk.Z));
+}
+
+int ATerrain::GetBlockType(const FIntVector& coord) {
+	openvdb::Coord voxel(coord.X, coord.Y, coord.Z);
+	return (int)m_readAccessor->getValue(voxel);
+}
+
+bool ATerrain::OverlapsSolid(const FBox& box) const {
+	const int32 minX = FMath::FloorToInt(box.Min.X / VoxelSize);
+	const int32 minY = FMath::FloorToInt(box.Min.Y / VoxelSize);
+	const int32 minZ = FMath::FloorToInt(box.Min.Z / VoxelSize);
+	const int32 maxX = FMath::FloorToInt(box.Max.X / VoxelSize);
+	const int32 maxY = FMath::FloorToInt(box.Max.Y / VoxelSize);
+	const int32 maxZ = FMath::FloorToInt(box.Max.Z / VoxelSize);
+
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	for (int32 z = minZ; z <= maxZ; ++z)
+		for (int32 y = minY; y <= maxY; ++y)
+			for (int32 x = minX; x <= maxX; ++x)
+				if (accessor.getValue(openvdb::Coord(x, y, z)) > 1)
+					return true;
+	return false;
+}
+
+bool ATerrain::OverlapsOccupied(const FBox& box) const {
+	const FIntVector min(
+		FMath::FloorToInt(box.Min.X / VoxelSize),
+		FMath::FloorToInt(box.Min.Y / VoxelSize),
+		FMath::FloorToInt(box.Min.Z / VoxelSize));
+	const FIntVector max(
+		FMath::FloorToInt(box.Max.X / VoxelSize),
+		FMath::FloorToInt(box.Max.Y / VoxelSize),
+		FMath::FloorToInt(box.Max.Z / VoxelSize));
+	return m_occupancy.Num() > 0 && IsOccupied(min, max);
+}
+
+void ATerrain::GetBoxCells(const FBox& box, FIntVector& min, FIntVector& max) const {
+	const float margin = VoxelSize * 0.1f;
+	min = FIntVector(
+		FMath::FloorToInt((box.Min.X + margin) / VoxelSize),
+		FMath::FloorToInt((box.Min.Y + margin) / VoxelSize),
+		FMath::FloorToInt((box.Min.Z + margin) / VoxelSize));
+	max = FIntVector(
+		FMath::FloorToInt((box.Max.X - margin) / VoxelSize),
+		FMath::FloorToInt((box.Max.Y - margin) / VoxelSize),
+		FMath::FloorToInt((box.Max.Z - margin) / VoxelSize));
+	// Boxes thinner than the margin still cover a cell
+	max = FIntVector(FMath::Max(min.X, max.X), FMath::Max(min.Y, max.Y), FMath::Max(min.Z, max.Z));
+}
+
+int32 ATerrain::AddOccupant(AActor* actor) {
+	if (!actor)
+		return -1;
+
+	// The root mesh is what the placement ghost shows, other components
+	// (reach spheres, triggers) do not hold cells
+	const UPrimitiveComponent* root = Cast<UPrimitiveComponent>(actor->GetRootComponent());
+	FIntVector min, max;
+	GetBoxCells(root ? root->Bounds.GetBox() : actor->GetComponentsBoundingBox(), min, max);
+	return AddOccupant(actor, min, max);
+}
+
+int32 ATerrain::AddOccupant(AActor* actor, const FIntVector& min, const FIntVector& max) {
+	if (!actor || IsOccupied(min, max))
+		return -1;
+
+	const int32 handle = m_nextOccupant++;
+	m_occupants.Add(handle, { actor, min, max });
+	actor->OnEndPlay.AddUniqueDynamic(this, &ATerrain::handleOccupantEndPlay);
+	for (int32 z = min.Z; z <= max.Z; ++z)
+		for (int32 y = min.Y; y <= max.Y; ++y)
+			for (int32 x = min.X; x <= max.X; ++x)
+				m_occupancy.Add(FIntVector(x, y, z), handle);
+	return handle;
+}
+
+void ATerrain::RemoveOccupant(int32 handle) {
+	Occupant occupant;
+	if (!m_occupants.RemoveAndCopyValue(handle, occupant))
+		return;
+
+	for (int32 z = occupant.min.Z; z <= occupant.max.Z; ++z)
+		for (int32 y = occupant.min.Y; y <= occupant.max.Y; ++y)
+			for (int32 x = occupant.min.X; x <= occupant.max.X; ++x)
+				m_occupancy.Remove(FIntVector(x, y, z));
+}
+
+bool ATerrain::IsOccupant(const AActor* actor) const {
+	for (const auto& entry : m_occupants)
+		if (entry.Value.actor.Get() == actor)
+			return true;
+	return false;
+}
+
+void ATerrain::handleOccupantEndPlay(AActor* actor, EEndPlayReason::Type reason) {
+	TArray<int32> handles;
+	for (const auto& entry : m_occupants)
+		if (entry.Value.actor.Get() == actor)
+			handles.Add(entry.Key);
+	for (int32 handle : handles)
+		RemoveOccupant(handle);
+}
+
+bool ATerrain::IsOccupied(const FIntVector& min, const FIntVector& max) const {
+	for (int32 z = min.Z; z <= max.Z; ++z)
+		for (int32 y = min.Y; y <= max.Y; ++y)
+			for (int32 x = min.X; x <= max.X; ++x)
+				if (m_occupancy.Contains(FIntVector(x, y, z)))
+					return true;
+	return false;
+}
+
+AActor* ATerrain::GetOccupant(const FIntVector& cell) const {
+	const int32* handle = m_occupancy.Find(cell);
+	const Occupant* occupant = handle ? m_occupants.Find(*handle) : nullptr;
+	return occupant ? occupant->actor.Get() : nullptr;
+}
+
+AActor* ATerrain::RaycastOccupant(const FVector& start, const FVector& end) {
+	const FVector origin = start / VoxelSize;
+	const FVector dir = (end - start) / VoxelSize;
+	const float o[3] = { origin.X, origin.Y, origin.Z };
+	const float d[3] = { dir.X, dir.Y, dir.Z };
+
+	// Stops on the first held or solid cell
+	AActor* hit = nullptr;
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	int32 voxel[3];
+	float t;
+	TerrainCore::WalkGrid(o, d, voxel, t, [&](const int32* v) {
+		hit = GetOccupant(FIntVector(v[0], v[1], v[2]));
+		return hit || accessor.getValue(openvdb::Coord(v[0], v[1], v[2])) > 1;
+	});
+	return hit;
+}
+
+bool ATerrain::IsGenerated(const FVector& location) const {
+	const FIntVector chunk = worldToChunkCoords(location.X, location.Y, location.Z);
+	return m_generatedChunks.Contains(getChunkIndex(chunk.X, chunk.Y, chunk.Z));
+}
+
+bool ATerrain::IsGenerated(const FBox& box) const {
+	const FIntVector min = worldToChunkCoords(box.Min.X, box.Min.Y, box.Min.Z);
+	const FIntVector max = worldToChunkCoords(box.Max.X, box.Max.Y, box.Max.Z);
+	for (int32 z = min.Z; z <= max.Z; ++z)
+		for (int32 y = min.Y; y <= max.Y; ++y)
+			for (int32 x = min.X; x <= max.X; ++x)
+				if (!m_generatedChunks.Contains(getChunkIndex(x, y, z)))
+					return false;
+	return true;
+}
+
+TArray<int32> ATerrain::GetBlockTypes(const FIntVector& min, const FIntVector& max) {
+	TArray<int32> types;
+	const FIntVector lo(FMath::Min(min.X, max.X), FMath::Min(min.Y, max.Y), FMath::Min(min.Z, max.Z));
+	const FIntVector hi(FMath::Max(min.X, max.X), FMath::Max(min.Y, max.Y), FMath::Max(min.Z, max.Z));
+	types.Reserve((hi.X - lo.X + 1) * (hi.Y - lo.Y + 1) * (hi.Z - lo.Z + 1));
+
+	// X innermost, consecutive reads mostly hit the cached leaf
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	for (int32 z = lo.Z; z <= hi.Z; ++z)
+		for (int32 y = lo.Y; y <= hi.Y; ++y)
+			for (int32 x = lo.X; x <= hi.X; ++x)
+				types.Add((int32)accessor.getValue(openvdb::Coord(x, y, z)));
+	return types;
+}
+
+TArray<int32> ATerrain::GetBlockTypesAt(const TArray<FIntVector>& coords) {
+	using LeafType = openvdb::FloatTree::LeafNodeType;
+	const int32 mask = ~(LeafType::DIM - 1);
+
+	// Visit coordinates leaf by leaf so the accessor cache is reused
+	TArray<int32> order;
+	order.Reserve(coords.Num());
+	for (int32 i = 0; i < coords.Num(); ++i)
+		order.Add(i);
+	order.Sort([&coords, mask](int32 a, int32 b) {
+		const FIntVector& ca = coords[a];
+		const FIntVector& cb = coords[b];
+		if ((ca.X & mask) != (cb.X & mask)) return (ca.X & mask) < (cb.X & mask);
+		if ((ca.Y & mask) != (cb.Y & mask)) return (ca.Y & mask) < (cb.Y & mask);
+		return (ca.Z & mask) < (cb.Z & mask);
+	});
+
+	TArray<int32> types;
+	types.SetNumUninitialized(coords.Num());
+	openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+	for (int32 i : order) {
+		const FIntVector& coord = coords[i];
+		types[i] = (int32)accessor.getValue(openvdb::Coord(coord.X, coord.Y, coord.Z));
+	}
+	return types;
 }
 
 // Called when the game starts or when spawned
 void ATerrain::BeginPlay()
 {
 	Super::BeginPlay();
+	m_startupTime = FPlatformTime::Seconds();
+	m_recorder.SetCapacity(FlightRecorderFrames);
+	TimeToFirstInteractiveFrame = -1;
+	StartupLoadTime = -1;
+
 	VoxelSize = Cast<UMyGameInstance>(GetGameInstance())->GetWorldUnitSize();
+
+	m_kernels = TerrainCore::SelectChunkKernels(ChunkSize);
+	if (!m_kernels) {
+		UE_LOG(LogTemp, Error, TEXT("Unsupported chunk size %d, using 32."), ChunkSize);
+		ChunkSize = 32;
+		m_kernels = TerrainCore::SelectChunkKernels(ChunkSize);
+	}
+	m_chunkShift = FMath::IsPowerOfTwo(ChunkSize) ? FMath::FloorLog2(ChunkSize) : -1;
 	m_chunkWorldSize = ChunkSize * VoxelSize;
 
-	openvdb::FloatGrid::Ptr grid = m_grid;
+	RootComponent->SetRelativeScale3D(FVector(VoxelSize));
+
+	m_packedMesh = bPackedChunkMesh && static_cast<int32>(ChunkSize) <= VoxelPackedMaxCoord;
+	if (bPackedChunkMesh && !m_packedMesh)
+		UE_LOG(LogTemp, Warning, TEXT("Chunk size %d too big for packed vertices, using procedural meshes."), ChunkSize);
+
+	// Triangle collision would need the procedural buffers packed meshes avoid
+	if (m_packedMesh && CollisionMode == ETerrainCollisionMode::Mesh) {
+		UE_LOG(LogTemp, Log, TEXT("Packed chunk meshes use merged box collision."));
+		CollisionMode = ETerrainCollisionMode::MergedBoxes;
+	}
+
+	AActor* player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
+	FVector spawnLoc = player ? player->GetActorLocation() : FVector::ZeroVector;
+
+	// Only the spawn column is generated up front to find the real surface
+	const int32 spawnX = FMath::FloorToInt(spawnLoc.X / VoxelSize);
+	const int32 spawnY = FMath::FloorToInt(spawnLoc.Y / VoxelSize);
+	int32 surface = 0;
+	const bool foundSurface = findSpawnSurface(spawnX, spawnY, surface);
+	const FIntVector spawnChunk = worldToChunkCoords(spawnLoc.X, spawnLoc.Y, (surface + 1) * VoxelSize);
+
+	// Keep starting zone loaded. Pending loads are meshed by shell over the next frames
+	AddStaticChunkTicket(spawnChunk, DbgChunkLoadRange, 0);
+
+	// Mesh the spawn column right away so there is ground under the player
+	const int32 range = DbgChunkLoadRange;
+	for (int32 k = -range; k <= range; ++k) {
+		const int64 chkIdx = getChunkIndex(spawnChunk.X, spawnChunk.Y, spawnChunk.Z + k);
+		if (m_pendingLoads.Remove(chkIdx) > 0)
+			loadChunk(chkIdx);
+	}
 
-	TBigInt<64> idx(getChunkIndex(0, 0, -1));
-	const short range = DbgChunkLoadRange;
-	const short preloadRange = range + 1;
+	// Teleport player to ground
+	if (player && foundSurface) {
+		const float playerHeight = player->GetComponentsBoundingBox().GetSize().Z + 10;
+		const float spawnHeight = (surface + 1) * VoxelSize + playerHeight;
+		spawnLoc.SetComponentForAxis(EAxis::Z, spawnHeight);
+		player->SetActorLocation(spawnLoc, false, nullptr, ETeleportType::ResetPhysics);
+	} else if (player)
+		UE_LOG(LogTemp, Error, TEXT("No ground found under spawn at (%d, %d)"), spawnX, spawnY);
+}
 
-	// Preload some chunks around starting zone
-	for (short i = -preloadRange; i < preloadRange; ++i) {
-		for (short j = -preloadRange; j < preloadRange; ++j) {
-			for (short k = -preloadRange; k < preloadRange; ++k) {
-				const uint64 chkIdx = getChunkIndex(i, j, k);
-				preloadChunk(chkIdx);
+bool ATerrain::findSpawnSurface(int32 x, int32 y, int32& surface) {
+	const int32 size = static_cast<int32>(ChunkSize);
+	// Perlin octaves add up to about [-2, 2], not [-1, 1]
+	const int32 top = 2 * FMath::CeilToInt(FMath::Abs(HeightFactor)) + 1;
+	const int32 chkX = FMath::FloorToInt(x / static_cast<float>(size));
+	const int32 chkY = FMath::FloorToInt(y / static_cast<float>(size));
+
+	for (int32 chkZ = FMath::FloorToInt(top / static_cast<float>(size)); (chkZ + 1) * size > -top; --chkZ) {
+		generateChunk(getChunkIndex(chkX, chkY, chkZ));
+
+		openvdb::FloatGrid::ConstAccessor& accessor = *m_readAccessor;
+		for (int32 z = (chkZ + 1) * size - 1; z >= chkZ * size; --z) {
+			// Anything above air (1) is solid
+			if (accessor.getValue(openvdb::Coord(x, y, z)) > 1) {
+				surface = z;
+
+				// Ground may still rise above the scanned range, climb to air
+				for (;;) {
+					const int32 above = surface + 1;
+					generateChunk(getChunkIndex(chkX, chkY, FMath::FloorToInt(above / static_cast<float>(size))));
+					if (m_readAccessor->getValue(openvdb::Coord(x, y, above)) <= 1)
+						return true;
+					surface = above;
+				}
 			}
 		}
 	}
-	for (short i = -range; i < range; ++i) {
-		for (short j = -range; j < range; ++j) {
-			for (short k = -range; k < range; ++k) {
-				const uint64 chkIdx = getChunkIndex(i, j, k);
-				loadChunk(chkIdx);
+	return false;
+}
+
+void ATerrain::Tick(float delta) {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainTick);
+
+	// Delta is the frame that just ended, including last tick's terrain work
+	const float frameMs = delta * 1000.f;
+	m_recorder.EndFrame(GFrameCounter, frameMs);
+	if (HitchThresholdMs > 0 && frameMs > HitchThresholdMs && TimeToFirstInteractiveFrame >= 0) {
+		const double now = FPlatformTime::Seconds();
+		if (now - m_lastHitchDump > MinHitchDumpInterval) {
+			m_lastHitchDump = now;
+			const FString path = DumpFlightRecorder(FString::Printf(TEXT("Hitch %.1f ms"), frameMs));
+			UE_LOG(LogTemp, Warning, TEXT("Terrain hitch of %.1f ms, flight recorder written to %s"), frameMs, *path);
+		}
+	}
+
+	if (TimeToFirstInteractiveFrame < 0) {
+		TimeToFirstInteractiveFrame = static_cast<float>((FPlatformTime::Seconds() - m_startupTime) * 1000.0);
+		UE_LOG(LogTemp, Log, TEXT("Terrain time to first interactive frame: %.2f ms"), TimeToFirstInteractiveFrame);
+	}
+
+	updateTickets();
+	if (m_lodsDirty) {
+		updateLods();
+		m_lodsDirty = false;
+		m_visibilityDirty = true;
+	}
+
+	if (bCullHiddenChunks) {
+		APlayerCameraManager* camera = UGameplayStatics::GetPlayerCameraManager(GetWorld(), 0);
+		if (camera) {
+			const FVector loc = camera->GetCameraLocation();
+			const FIntVector cameraChunk = worldToChunkCoords(loc.X, loc.Y, loc.Z);
+			if (m_visibilityDirty || !m_visibilityReady || cameraChunk != m_cameraChunk) {
+				m_cameraChunk = cameraChunk;
+				updateVisibility();
 			}
 		}
 	}
 
-	RootComponent->SetRelativeScale3D(FVector(VoxelSize));
+	processPendingLoads(MaxChunkLoadsPerTick);
 
-	// Teleport player to ground
-	const int size = static_cast<int>(ChunkSize);
-	AActor* player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
-	const float playerHeight = player->GetComponentsBoundingBox().GetSize().Z + 10;
-	const float spawnHeight = (m_heightMap.GetValue(0, 0) * HeightFactor * VoxelSize) + playerHeight;
-	FVector spawnLoc = player->GetActorLocation();
-	spawnLoc.SetComponentForAxis(EAxis::Z, spawnHeight);
-	player->SetActorLocation(spawnLoc, false, nullptr, ETeleportType::ResetPhysics);
-}
+	if (StartupLoadTime < 0 && m_pendingLoads.Num() == 0) {
+		StartupLoadTime = static_cast<float>((FPlatformTime::Seconds() - m_startupTime) * 1000.0);
+		UE_LOG(LogTemp, Log, TEXT("Terrain startup shells loaded in: %.2f ms"), StartupLoadTime);
+	}
 
-void ATerrain::Tick(float delta) {
+	SET_DWORD_STAT(STAT_TerrainDirtyChunks, m_dirtyChunks.Num());
+	m_recorder.Current().pendingLoads = m_pendingLoads.Num();
+	m_recorder.Current().dirtyChunks = m_dirtyChunks.Num();
 	for (size_t i = 0; i < m_dirtyChunks.Num(); ++i) {
-		loadChunk(m_dirtyChunks[i]);
+		// Edits next to a non resident chunk must not load it
+		if (m_chunks.Contains(m_dirtyChunks[i]))
+			loadChunk(m_dirtyChunks[i]);
 	}
 	m_dirtyChunks.Empty();
+
+	SET_DWORD_STAT(STAT_TerrainResidentChunks, m_chunks.Num());
+	SET_DWORD_STAT(STAT_TerrainPendingLoads, m_pendingLoads.Num());
+	SET_DWORD_STAT(STAT_TerrainVertices, m_totalVertices);
+	SET_DWORD_STAT(STAT_TerrainTriangles, m_totalTriangles);
+#if STATS
+	// Walks the whole tree, only worth it when someone is looking
+	if (m_gridMemoryDirty && FThreadStats::IsCollectingData()) {
+		SET_MEMORY_STAT(STAT_TerrainGridMemory, m_grid->memUsage());
+		m_gridMemoryDirty = false;
+	}
+#endif
+}
+
+FString ATerrain::DumpFlightRecorder(const FString& reason) {
+	TArray<FString> context;
+	const APawn* player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
+	if (player) {
+		const FVector loc = player->GetActorLocation();
+		const FIntVector chunk = worldToChunkCoords(loc.X, loc.Y, loc.Z);
+		context.Add(FString::Printf(TEXT("Player,%.1f,%.1f,%.1f,Chunk,%d,%d,%d"), loc.X, loc.Y, loc.Z, chunk.X, chunk.Y, chunk.Z));
+	}
+
+	FString dirty = FString::Printf(TEXT("DirtyChunks,%d"), m_dirtyChunks.Num());
+	for (const int64 index : m_dirtyChunks) {
+		const FIntVector chunk = getChunkCoords(index);
+		dirty += FString::Printf(TEXT(",%d %d %d"), chunk.X, chunk.Y, chunk.Z);
+	}
+	context.Add(dirty);
+
+	FString pending = FString::Printf(TEXT("PendingLoads,%d"), m_pendingLoads.Num());
+	for (const auto& entry : m_pendingLoads) {
+		const FIntVector chunk = getChunkCoords(entry.Key);
+		pending += FString::Printf(TEXT(",%d %d %d"), chunk.X, chunk.Y, chunk.Z);
+	}
+	context.Add(pending);
+	context.Add(FString::Printf(TEXT("ResidentChunks,%d"), m_chunks.Num()));
+
+	return m_recorder.Dump(reason, context);
+}
+
+int32 ATerrain::AddChunkTicket(AActor* owner, int32 radius, int32 priority) {
+	if (!owner) {
+		UE_LOG(LogTemp, Error, TEXT("Chunk ticket needs an owner!"));
+		return -1;
+	}
+	ChunkTicket ticket;
+	ticket.owner = owner;
+	const FVector loc = owner->GetActorLocation();
+	ticket.center = worldToChunkCoords(loc.X, loc.Y, loc.Z);
+	ticket.radius = FMath::Max(radius, 0);
+	ticket.priority = priority;
+	ticket.isStatic = false;
+	return addTicket(ticket);
+}
+
+int32 ATerrain::AddStaticChunkTicket(const FIntVector& chunkCoords, int32 radius, int32 priority) {
+	ChunkTicket ticket;
+	ticket.center = chunkCoords;
+	ticket.radius = FMath::Max(radius, 0);
+	ticket.priority = priority;
+	ticket.isStatic = true;
+	return addTicket(ticket);
+}
+
+void ATerrain::RemoveChunkTicket(int32 ticket) {
+	ChunkTicket removed;
+	if (m_tickets.RemoveAndCopyValue(ticket, removed)) {
+		releaseChunks(removed);
+		m_lodsDirty = true;
+	}
+}
+
+int32 ATerrain::GetViewRadius() const {
+	return LodRanges.Num() > 0 ? LodRanges.Last() : 0;
+}
+
+bool ATerrain::IsChunkResident(const FIntVector& chunkCoords) const {
+	return m_chunkRefs.Contains(getChunkIndex(chunkCoords.X, chunkCoords.Y, chunkCoords.Z));
+}
+
+int32 ATerrain::addTicket(const ChunkTicket& ticket) {
+	m_lodsDirty = true;
+	const int32 id = m_nextTicket++;
+	m_tickets.Add(id, ticket);
+	acquireChunks(ticket);
+	return id;
+}
+
+void ATerrain::acquireChunks(const ChunkTicket& ticket) {
+	const int32 r = ticket.radius;
+	for (int32 i = -r; i <= r; ++i) {
+		for (int32 j = -r; j <= r; ++j) {
+			for (int32 k = -r; k <= r; ++k) {
+				const int64 chkIdx = getChunkIndex(
+					ticket.center.X + i,
+					ticket.center.Y + j,
+					ticket.center.Z + k);
+				// Chebyshev distance so chunks load in concentric shells
+				const int32 distance = FMath::Max3(FMath::Abs(i), FMath::Abs(j), FMath::Abs(k));
+
+				int32& refs = m_chunkRefs.FindOrAdd(chkIdx);
+				if (++refs == 1 && !m_chunks.Contains(chkIdx)) {
+					PendingLoad load;
+					load.priority = ticket.priority;
+					load.distance = distance;
+					m_pendingLoads.Add(chkIdx, load);
+				} else if (PendingLoad* load = m_pendingLoads.Find(chkIdx)) {
+					// Shared chunk, keep the most urgent request
+					load->priority = FMath::Max(load->priority, ticket.priority);
+					load->distance = FMath::Min(load->distance, distance);
+				}
+			}
+		}
+	}
+}
+
+void ATerrain::releaseChunks(const ChunkTicket& ticket) {
+	const int32 r = ticket.radius;
+	for (int32 i = -r; i <= r; ++i) {
+		for (int32 j = -r; j <= r; ++j) {
+			for (int32 k = -r; k <= r; ++k) {
+				const int64 chkIdx = getChunkIndex(
+					ticket.center.X + i,
+					ticket.center.Y + j,
+					ticket.center.Z + k);
+
+				int32* refs = m_chunkRefs.Find(chkIdx);
+				if (!refs || --(*refs) > 0)
+					continue;
+
+				m_chunkRefs.Remove(chkIdx);
+				m_pendingLoads.Remove(chkIdx);
+				unloadChunk(chkIdx);
+			}
+		}
+	}
+}
+
+void ATerrain::updateTickets() {
+	TArray<int32> expired;
+	for (auto& entry : m_tickets) {
+		ChunkTicket& ticket = entry.Value;
+		if (ticket.isStatic)
+			continue;
+
+		AActor* owner = ticket.owner.Get();
+		if (!owner) {
+			expired.Add(entry.Key);
+			continue;
+		}
+
+		const FVector loc = owner->GetActorLocation();
+		const FIntVector center = worldToChunkCoords(loc.X, loc.Y, loc.Z);
+		if (center == ticket.center)
+			continue;
+
+		// Acquire new area before releasing the old one so overlap stays loaded
+		const ChunkTicket previous = ticket;
+		ticket.center = center;
+		acquireChunks(ticket);
+		releaseChunks(previous);
+		m_lodsDirty = true;
+	}
+
+	for (int32 id : expired)
+		RemoveChunkTicket(id);
+}
+
+void ATerrain::processPendingLoads(int32 budget) {
+	if (m_pendingLoads.Num() == 0 || budget <= 0)
+		return;
+
+	m_pendingLoads.ValueSort([](const PendingLoad& a, const PendingLoad& b) {
+		if (a.priority != b.priority)
+			return a.priority > b.priority;
+		return a.distance < b.distance;
+	});
+
+	TArray<int64> loaded;
+	for (const auto& entry : m_pendingLoads) {
+		if (loaded.Num() >= budget)
+			break;
+		loadChunk(entry.Key);
+		loaded.Add(entry.Key);
+	}
+
+	for (int64 chkIdx : loaded)
+		m_pendingLoads.Remove(chkIdx);
 }
 
 UProceduralMeshComponent* ATerrain::getChunk(uint64 index) {
@@ -269,63 +1081,37 @@ int64 ATerrain::getChunkIndex(short x, short y, short z) const {
 	return result.ToInt();
 }
 
+void ATerrain::generateChunk(int64 index) {
+	// Voxel data outlives chunk residency, only generate once
+	if (m_generatedChunks.Contains(index)) return;
+	m_generatedChunks.Add(index);
+	SCOPE_CYCLE_COUNTER(STAT_TerrainGenerateChunk);
+	FTerrainRecorderScope recorderScope(m_recorder.Current().generateMs);
+	++m_recorder.Current().chunksGenerated;
+
+	const FIntVector chunkCoords = getChunkCoords(index);
+	SurfaceColumn& column = getSurfaceColumn(chunkCoords);
+
+	TerrainCore::ChunkGenerationInput input;
+	input.grid = m_grid.get();
+	input.groundNoise = &m_groundNoiseModule;
+	input.oreNoise = &m_oreNoiseModule;
+	input.heightFactor = HeightFactor;
+	input.chunkCoords = { chunkCoords.X, chunkCoords.Y, chunkCoords.Z };
+	input.columnTops = column.heights.GetData();
+	m_kernels->generate(input, ChunkSize);
+
+	// Optimize grid sparseness
+	m_grid->pruneGrid();
+	gridChanged();
+}
+
 void ATerrain::preloadChunk(int64 index) {
 	// Check not preloaded already
 	if (m_chunks.Contains(index)) return;
+	SCOPE_CYCLE_COUNTER(STAT_TerrainPreloadChunk);
 
-	// Check content exists
-	const FIntVector chunkCoords = getChunkCoords(index);
-	const FIntVector chunkVoxel = chunkCoords * ChunkSize;
-	openvdb::FloatGrid::Accessor accessor = m_grid->getAccessor();
-	const openvdb::Coord chunkSample(chunkVoxel.X, chunkVoxel.Y, chunkVoxel.Z);
-
-	const float value = accessor.getValue(chunkSample);
-	if (value == 0) {
-		const FVector center = VoxelSize * (FVector(chunkVoxel.X, chunkVoxel.Y, chunkVoxel.Z) + FVector(ChunkSize / 2.0));
-		const FVector extent = VoxelSize * FVector(ChunkSize / 2.0) * 0.9;
-
-		// Compute fractal (generate noise)
-		const int size = static_cast<int>(ChunkSize);
-
-		const int Ox = chunkVoxel.X;
-		const int Oy = chunkVoxel.Y;
-		const int Oz = chunkVoxel.Z;
-		const int chkWidth = Ox + size - 1;
-		const int chkDepth = Oy + size - 1;
-		const int chkHeight = Oz + size - 1;
-		// First fill with air
-		const openvdb::CoordBBox chunk(Ox, Oy, Oz, chkWidth, chkDepth, chkHeight);
-		m_grid->fill(chunk, 1.0, false);
-
-		for (int i = Ox; i <= chkWidth; ++i) {
-			for (int j = Oy; j <= chkDepth; ++j) {
-				const int height = m_groundNoiseModule
-					.GetValue(
-						i / 128.0,
-						j / 128.0,
-						0) * HeightFactor;
-
-				const openvdb::Coord lowest(i, j, Oz);
-				const openvdb::Coord level(i, j, height >= chkHeight ? chkHeight : height);
-
-				// Fill voxel grid
-				const openvdb::CoordBBox gndBbox(lowest, level);
-				m_grid->fill(gndBbox, 2.0, true);
-
-				for (int k = -Oz; k <= height; ++k) {
-					if (m_oreNoiseModule.GetValue(i / 32.0, j / 32.0, k / 32.0) > 0.5) {
-						const openvdb::Coord crd(i, j, k);
-						accessor.setValue(crd, 3.0);
-					}
-				}
-			}
-		}
-		// Optimize grid sparseness
-		m_grid->pruneGrid();
-	}
-	else
-		UE_LOG(LogTemp, Warning, TEXT("Chunk at %s already generated"), *chunkCoords.ToString());
-
+	generateChunk(index);
 
 	// Create mesh
 	UProceduralMeshComponent* mesh = NewObject<UProceduralMeshComponent>(this);
@@ -335,17 +1121,99 @@ void ATerrain::preloadChunk(int64 index) {
 		return;
 	}
 
-	const FVector chunkLocation = FVector(chunkVoxel.X, chunkVoxel.Y, chunkVoxel.Z) / 2;
-
-	mesh->bUseComplexAsSimpleCollision = true;
+	// Cook off the game thread, the previous collision stays until done
+	mesh->bUseAsyncCooking = true;
+	mesh->bUseComplexAsSimpleCollision = CollisionMode == ETerrainCollisionMode::Mesh;
 	mesh->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
 	m_chunks.Add(index, mesh);
+
+	if (m_packedMesh) {
+		mesh->SetVisibility(false);
+
+		UVoxelChunkComponent* packed = NewObject<UVoxelChunkComponent>(this);
+		packed->RegisterComponent();
+		packed->AttachToComponent(RootComponent, FAttachmentTransformRules::KeepRelativeTransform);
+		packed->SetRelativeLocation(FVector(getChunkCoords(index) * ChunkSize));
+		m_packedChunks.Add(index, packed);
+	}
+}
+
+void ATerrain::setChunkVisibility(int64 index, bool visible) {
+	if (m_packedMesh) {
+		UVoxelChunkComponent** packed = m_packedChunks.Find(index);
+		if (packed)
+			(*packed)->SetVisibility(visible);
+	} else {
+		UProceduralMeshComponent** mesh = m_chunks.Find(index);
+		if (mesh)
+			(*mesh)->SetVisibility(visible);
+	}
 }
 
 void ATerrain::loadChunk(int64 index) {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainLoadChunk);
+	INC_DWORD_STAT(STAT_TerrainChunksLoaded);
+
 	if (!m_chunks.Contains(index)) {
 		preloadChunk(index);
 	}
+
+	// Neighbours must exist for boundary faces to be culled correctly
+	const FIntVector chunkCoords = getChunkCoords(index);
+	for (size_t dir = 0; dir < 6; ++dir)
+		generateChunk(getChunkIndex(
+			chunkCoords.X + ChunkNeighbours[dir][0],
+			chunkCoords.Y + ChunkNeighbours[dir][1],
+			chunkCoords.Z + ChunkNeighbours[dir][2]));
+
+	ChunkLod& chunkLod = m_chunkLods.FindOrAdd(index);
+	chunkLod.lod = computeChunkLod(chunkCoords);
+	chunkLod.skirts = 0;
+	for (size_t dir = 0; dir < 6; ++dir) {
+		const int64 neighbour = getChunkIndex(
+			chunkCoords.X + ChunkNeighbours[dir][0],
+			chunkCoords.Y + ChunkNeighbours[dir][1],
+			chunkCoords.Z + ChunkNeighbours[dir][2]);
+		ChunkLod* other = m_chunkLods.Find(neighbour);
+		if (!other)
+			continue;
+
+		const bool differs = other->lod != chunkLod.lod;
+		if (differs)
+			chunkLod.skirts |= 1 << dir;
+
+		// Neighbour must stitch against us if it did not expect this LOD (opposite side is dir ^ 1)
+		const bool neighbourSkirt = (other->skirts & (1 << (dir ^ 1))) != 0;
+		if (neighbourSkirt != differs)
+			m_dirtyChunks.AddUnique(neighbour);
+	}
+	const int32 lod = chunkLod.lod;
+	const uint8 skirts = chunkLod.skirts;
+	UProceduralMeshComponent* mesh = m_chunks[index];
+
+	TArray<uint8> cells;
+	{
+		FTerrainRecorderScope recorderScope(m_recorder.Current().meshMs);
+		buildCells(chunkCoords, lod, cells);
+	}
+
+	const uint16 connectivity = computeConnectivity(cells, lod);
+	const uint16* previous = m_chunkConnectivity.Find(index);
+	if (!previous || *previous != connectivity) {
+		m_chunkConnectivity.Add(index, connectivity);
+		m_visibilityDirty = true;
+	}
+
+	// Chunks no air path leads to only get their collision, they are meshed
+	// for display once they become visible
+	const bool hidden = bCullHiddenChunks && m_visibilityReady && !m_visibleChunks.Contains(index);
+	if (hidden) {
+		m_unmeshedChunks.Add(index);
+		setChunkVisibility(index, false);
+	} else {
+		m_unmeshedChunks.Remove(index);
+	}
+
 	TArray<FVector> vertices;
 	TArray<int32> triangles;
 	TArray<FVector> normals;
@@ -354,55 +1222,359 @@ void ATerrain::loadChunk(int64 index) {
 	TArray<FLinearColor> colors;
 	TArray<FProcMeshTangent> tangents;
 
-	const FIntVector chunkVoxel = getChunkCoords(index) * ChunkSize;
-	const int Ox = chunkVoxel.X;
-	const int Oy = chunkVoxel.Y;
-	const int Oz = chunkVoxel.Z;
+	// Coarse geometry is only for display
+	const bool collision = lod == 0;
+	const bool meshCollision = collision && CollisionMode == ETerrainCollisionMode::Mesh;
+
+	// Rendered geometry, for stats
+	ChunkMeshStats meshStats = { 0, 0 };
+	if (!hidden || meshCollision)
+		++m_recorder.Current().chunksMeshed;
+	auto createSection = [&](int32 section, bool sectionCollision) {
+		SCOPE_CYCLE_COUNTER(STAT_TerrainCreateMeshSection);
+		// Triangle collision is set up by the section itself
+		SCOPE_CONDITIONAL_CYCLE_COUNTER(STAT_TerrainCollision, sectionCollision);
+		FTerrainRecorderScope recorderScope(m_recorder.Current().uploadMs);
+		++m_recorder.Current().chunksUploaded;
+		mesh->CreateMeshSection_LinearColor(section, vertices, triangles, normals, uv, colors, tangents, sectionCollision);
+		meshStats.vertices += vertices.Num();
+		meshStats.triangles += triangles.Num() / 3;
+	};
 
-	const int size = static_cast<int>(ChunkSize);
-	const openvdb::CoordBBox chunk(Ox, Oy, Oz, Ox + size - 1, Oy + size - 1, Oz + size - 1);
+	if (hidden) {
+		// Stale render sections stay hidden, triangle collision needs its
+		// section rebuilt
+		if (meshCollision) {
+			processChunk(cells, chunkCoords, lod, skirts, vertices, triangles, normals, TerrainCore::AllSolidTypes);
+			createSection(0, true);
+			if (mesh->GetNumSections() > 1)
+				mesh->ClearMeshSection(1);
+			meshStats = { 0, 0 };
+		}
+	} else if (m_packedMesh) {
+		TArray<FVoxelPackedVertex> packedVertices;
+		TArray<uint32> indices;
+		processChunkPacked(cells, lod, skirts, packedVertices, indices);
+		meshStats.vertices = packedVertices.Num();
+		meshStats.triangles = indices.Num() / 3;
+		{
+			SCOPE_CYCLE_COUNTER(STAT_TerrainCreateMeshSection);
+			FTerrainRecorderScope recorderScope(m_recorder.Current().uploadMs);
+			++m_recorder.Current().chunksUploaded;
+			UVoxelChunkComponent* packed = m_packedChunks[index];
+			packed->SetMesh(packedVertices, indices);
+			packed->SetMaterial(0, GroundMaterial);
+		}
 
-	UProceduralMeshComponent* mesh = m_chunks[index];
+		// The procedural mesh is hidden and only holds the collision boxes
+		mesh->ClearAllMeshSections();
+	} else if (bSingleMeshSection) {
+		processChunk(cells, chunkCoords, lod, skirts, vertices, triangles, normals, TerrainCore::AllSolidTypes, &colors);
+		createSection(0, meshCollision);
+		if (mesh->GetNumSections() > 1)
+			mesh->ClearMeshSection(1);
+		mesh->SetMaterial(0, GroundMaterial);
+	} else {
+		processChunk(cells, chunkCoords, lod, skirts, vertices, triangles, normals, 2);
+		createSection(0, meshCollision);
+
+		vertices.Reset();
+		triangles.Reset();
+		normals.Reset();
+		processChunk(cells, chunkCoords, lod, skirts, vertices, triangles, normals, 3);
+		createSection(1, meshCollision);
+
+		mesh->SetMaterial(0, GroundMaterial);
+		mesh->SetMaterial(1, CoalOreMaterial);
+	}
 
-	processChunk(chunk, vertices, triangles, normals, 2);
-	mesh->CreateMeshSection_LinearColor(0, vertices, triangles, normals, uv, colors, tangents, true);
+	if (CollisionMode == ETerrainCollisionMode::MergedBoxes) {
+		SCOPE_CYCLE_COUNTER(STAT_TerrainCollision);
+		FTerrainRecorderScope recorderScope(m_recorder.Current().collisionMs);
+		TArray<TArray<FVector>> boxes;
+		if (collision)
+			buildCollisionBoxes(cells, chunkCoords, boxes);
+		mesh->SetCollisionConvexMeshes(boxes);
+	}
 
-	processChunk(chunk, vertices, triangles, normals, 3);
-	mesh->CreateMeshSection_LinearColor(1, vertices, triangles, normals, uv, colors, tangents, true);
-	
-	mesh->SetMaterial(0, GroundMaterial);
-	mesh->SetMaterial(1, CoalOreMaterial);
+	setChunkMeshStats(index, meshStats);
 }
 
-void ATerrain::processChunk(const openvdb::CoordBBox& bbox, TArray<FVector>& vertices, TArray<int32>& triangles, TArray<FVector>& normals, int voxelType) {
-	openvdb::FloatGrid::Accessor accessor = m_grid->getAccessor();
+void ATerrain::setChunkMeshStats(int64 index, const ChunkMeshStats& stats) {
+	ChunkMeshStats& current = m_chunkMeshStats.FindOrAdd(index);
+	m_totalVertices += stats.vertices - current.vertices;
+	m_totalTriangles += stats.triangles - current.triangles;
+	current = stats;
+}
+
+int32 ATerrain::computeChunkLod(const FIntVector& chunkCoords) const {
+	int32 distance = MAX_int32;
+	for (const auto& entry : m_tickets) {
+		const FIntVector d = chunkCoords - entry.Value.center;
+		distance = FMath::Min(distance, FMath::Max3(FMath::Abs(d.X), FMath::Abs(d.Y), FMath::Abs(d.Z)));
+	}
 
-	for (openvdb::CoordBBox::ZYXIterator it = bbox.beginZYX(); it; ++it) {
-		const openvdb::Coord coord = *it;
-		const float value = accessor.getValue(coord);
+	int32 lod = 0;
+	while (lod < LodRanges.Num() && distance > LodRanges[lod])
+		++lod;
 
-		if (value != voxelType)
+	// Cells must tile the chunk exactly
+	while (lod > 0 && (ChunkSize % (1 << lod)) != 0)
+		--lod;
+	return lod;
+}
+
+void ATerrain::updateLods() {
+	for (const auto& entry : m_chunkLods) {
+		const FIntVector chunkCoords = getChunkCoords(entry.Key);
+		if (computeChunkLod(chunkCoords) == entry.Value.lod)
 			continue;
 
-		const bool nx = 1 == accessor.getValue(coord.offsetBy(-1, 0, 0));
-		const bool px = 1 == accessor.getValue(coord.offsetBy(1, 0, 0));
+		// Stitching of neighbours is updated when this chunk is remeshed
+		m_dirtyChunks.AddUnique(entry.Key);
+	}
+}
+
+uint16 ATerrain::computeConnectivity(const TArray<uint8>& cells, int32 lod) const {
+	return m_kernels->computeConnectivity(cells.GetData(), lod, ChunkSize);
+}
+
+void ATerrain::updateVisibility() {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainVisibility);
+
+	struct Step {
+		int64 index;
+		FIntVector coords;
+		int32 entry;
+		// Directions walked so far, never walk back towards the camera
+		uint8 dirs;
+	};
+
+	m_visibilityDirty = false;
+	m_visibilityReady = true;
+	m_visibleChunks.Reset();
+
+	// Breadth first from the camera chunk, only crossing chunks through faces
+	// connected by air. Chunks not loaded yet are assumed open.
+	TArray<Step> queue;
+	m_visibleChunks.Add(getChunkIndex(m_cameraChunk.X, m_cameraChunk.Y, m_cameraChunk.Z));
+	for (int32 dir = 0; dir < 6; ++dir) {
+		const FIntVector coords = m_cameraChunk + FIntVector(ChunkNeighbours[dir][0], ChunkNeighbours[dir][1], ChunkNeighbours[dir][2]);
+		const int64 index = getChunkIndex(coords.X, coords.Y, coords.Z);
+		if (!m_chunkRefs.Contains(index))
+			continue;
+		m_visibleChunks.Add(index);
+		queue.Add({ index, coords, dir ^ 1, static_cast<uint8>(1 << dir) });
+	}
+
+	for (int32 head = 0; head < queue.Num(); ++head) {
+		const Step step = queue[head];
+		const uint16* connectivity = m_chunkConnectivity.Find(step.index);
+
+		for (int32 exit = 0; exit < 6; ++exit) {
+			if (step.dirs & (1 << (exit ^ 1)))
+				continue;
+			if (connectivity && !(*connectivity & (1 << TerrainCore::FacePairBit(step.entry, exit))))
+				continue;
+
+			const FIntVector coords = step.coords + FIntVector(ChunkNeighbours[exit][0], ChunkNeighbours[exit][1], ChunkNeighbours[exit][2]);
+			const int64 index = getChunkIndex(coords.X, coords.Y, coords.Z);
+			if (!m_chunkRefs.Contains(index) || m_visibleChunks.Contains(index))
+				continue;
+
+			m_visibleChunks.Add(index);
+			queue.Add({ index, coords, exit ^ 1, static_cast<uint8>(step.dirs | (1 << exit)) });
+		}
+	}
+
+	for (auto& entry : m_chunks) {
+		const bool visible = m_visibleChunks.Contains(entry.Key);
+		setChunkVisibility(entry.Key, visible);
+		if (visible && m_unmeshedChunks.Contains(entry.Key))
+			m_dirtyChunks.AddUnique(entry.Key);
+	}
+}
+
+void ATerrain::buildCells(const FIntVector& chunkCoords, int32 lod, TArray<uint8>& cells) const {
+	cells.SetNumUninitialized(TerrainCore::CellCount(ChunkSize, lod));
+	m_kernels->buildCells(*m_readAccessor, { chunkCoords.X, chunkCoords.Y, chunkCoords.Z }, lod, ChunkSize, cells.GetData());
+}
+
+void ATerrain::buildCollisionBoxes(const TArray<uint8>& cells, const FIntVector& chunkCoords, TArray<TArray<FVector>>& boxes) const {
+	const int32 size = static_cast<int32>(ChunkSize);
+	const int32 dim = size + 2;
+	const FIntVector origin = chunkCoords * size;
+
+	// Only solid voxels touching air need a collider
+	TBitArray<> exposed(false, size * size * size);
+	for (int32 z = 1; z <= size; ++z) {
+		for (int32 y = 1; y <= size; ++y) {
+			for (int32 x = 1; x <= size; ++x) {
+				const int32 idx = x + (y + z * dim) * dim;
+				if (cells[idx] <= 1)
+					continue;
+
+				if (1 == cells[idx - 1] || 1 == cells[idx + 1] ||
+					1 == cells[idx - dim] || 1 == cells[idx + dim] ||
+					1 == cells[idx - dim * dim] || 1 == cells[idx + dim * dim])
+					exposed[(x - 1) + ((y - 1) + (z - 1) * size) * size] = true;
+			}
+		}
+	}
+
+	auto isSet = [&](int32 x, int32 y, int32 z) -> bool {
+		return exposed[x + (y + z * size) * size];
+	};
+
+	// Greedy merge, grow each box along X, then Y, then Z
+	for (int32 z = 0; z < size; ++z) {
+		for (int32 y = 0; y < size; ++y) {
+			for (int32 x = 0; x < size; ++x) {
+				if (!isSet(x, y, z))
+					continue;
+
+				int32 ex = x + 1;
+				while (ex < size && isSet(ex, y, z))
+					++ex;
+
+				int32 ey = y + 1;
+				for (bool grow = true; grow && ey < size; ) {
+					for (int32 i = x; i < ex && grow; ++i)
+						grow = isSet(i, ey, z);
+					if (grow)
+						++ey;
+				}
+
+				int32 ez = z + 1;
+				for (bool grow = true; grow && ez < size; ) {
+					for (int32 j = y; j < ey && grow; ++j)
+						for (int32 i = x; i < ex && grow; ++i)
+							grow = isSet(i, j, ez);
+					if (grow)
+						++ez;
+				}
+
+				for (int32 k = z; k < ez; ++k)
+					for (int32 j = y; j < ey; ++j)
+						for (int32 i = x; i < ex; ++i)
+							exposed[i + (j + k * size) * size] = false;
+
+				const FVector lo(origin.X + x, origin.Y + y, origin.Z + z);
+				const FVector hi(origin.X + ex, origin.Y + ey, origin.Z + ez);
+				boxes.AddDefaulted();
+				TArray<FVector>& box = boxes.Last();
+				box.Reserve(8);
+				box.Add(FVector(lo.X, lo.Y, lo.Z));
+				box.Add(FVector(hi.X, lo.Y, lo.Z));
+				box.Add(FVector(lo.X, hi.Y, lo.Z));
+				box.Add(FVector(hi.X, hi.Y, lo.Z));
+				box.Add(FVector(lo.X, lo.Y, hi.Z));
+				box.Add(FVector(hi.X, lo.Y, hi.Z));
+				box.Add(FVector(lo.X, hi.Y, hi.Z));
+				box.Add(FVector(hi.X, hi.Y, hi.Z));
+			}
+		}
+	}
+}
 
-		const bool ny = 1 == accessor.getValue(coord.offsetBy(0, -1, 0));
-		const bool py = 1 == accessor.getValue(coord.offsetBy(0, 1, 0));
+void ATerrain::unloadChunk(int64 index) {
+	UProceduralMeshComponent* mesh = nullptr;
+	m_chunkLods.Remove(index);
+	m_chunkConnectivity.Remove(index);
+	m_unmeshedChunks.Remove(index);
+	setChunkMeshStats(index, { 0, 0 });
+	m_chunkMeshStats.Remove(index);
 
-		const bool nz = 1 == accessor.getValue(coord.offsetBy(0, 0, -1));
-		const bool pz = 1 == accessor.getValue(coord.offsetBy(0, 0, 1));
+	UVoxelChunkComponent* packed = nullptr;
+	if (m_packedChunks.RemoveAndCopyValue(index, packed))
+		packed->DestroyComponent();
 
-		if (nx || px || ny || py || nz || pz) {
-			// Create faces
-			if (nx) AddFace(0, coord.asPointer(), vertices, triangles, normals);
-			if (px) AddFace(1, coord.asPointer(), vertices, triangles, normals);
+	if (!m_chunks.RemoveAndCopyValue(index, mesh))
+		return;
+	mesh->DestroyComponent();
+}
 
-			if (ny) AddFace(2, coord.asPointer(), vertices, triangles, normals);
-			if (py) AddFace(3, coord.asPointer(), vertices, triangles, normals);
+void ATerrain::processChunk(
+	const TArray<uint8>& cells,
+	const FIntVector& chunkCoords,
+	int32 lod,
+	uint8 skirts,
+	TArray<FVector>& vertices,
+	TArray<int32>& triangles,
+	TArray<FVector>& normals,
+	int voxelType,
+	TArray<FLinearColor>* colors) {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainProcessChunk);
+	FTerrainRecorderScope recorderScope(m_recorder.Current().meshMs);
+
+	const int32 cellSize = 1 << lod;
+	const FIntVector origin = chunkCoords * ChunkSize;
+
+	std::vector<TerrainCore::ChunkFace> faces;
+	m_kernels->collectFaces(cells.GetData(), lod, skirts, voxelType, ChunkSize, faces);
+	for (const TerrainCore::ChunkFace& face : faces) {
+		const int32 coord[3] = {
+			origin.X + (face.x << lod),
+			origin.Y + (face.y << lod),
+			origin.Z + (face.z << lod)
+		};
+		AddFace(face.dir, coord, cellSize, vertices, triangles, normals);
+		if (colors) {
+			const FLinearColor material((face.type - 2) / 255.f, 0.f, 0.f, 1.f);
+			for (size_t i = 0; i < 4; ++i)
+				colors->Add(material);
+		}
+	}
+}
+
+void ATerrain::processChunkPacked(
+	const TArray<uint8>& cells,
+	int32 lod,
+	uint8 skirts,
+	TArray<uint32>& vertices,
+	TArray<uint32>& indices) {
+	SCOPE_CYCLE_COUNTER(STAT_TerrainProcessChunk);
+	FTerrainRecorderScope recorderScope(m_recorder.Current().meshMs);
+
+	const int32 size = 1 << lod;
+
+	// Same corners and winding as AddFace
+	const int32 corners[8][3] = {
+		{ 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 1 },
+		{ 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 0 }, { 1, 1, 1 }
+	};
+	const int32 faceVertices[6][4] = {
+		{ 0, 1, 2, 3 },
+		{ 4, 5, 6, 7 },
+		{ 0, 1, 4, 5 },
+		{ 2, 3, 6, 7 },
+		{ 0, 2, 4, 6 },
+		{ 1, 3, 5, 7 }
+	};
+	const int32 faceIndices[6][6] = {
+		{ 0, 2, 1, 2, 3, 1 },
+		{ 1, 3, 2, 1, 2, 0 },
+		{ 1, 3, 2, 1, 2, 0 },
+		{ 0, 2, 1, 2, 3, 1 },
+		{ 0, 2, 1, 2, 3, 1 },
+		{ 1, 3, 2, 1, 2, 0 },
+	};
 
-			if (nz) AddFace(4, coord.asPointer(), vertices, triangles, normals);
-			if (pz) AddFace(5, coord.asPointer(), vertices, triangles, normals);
+	std::vector<TerrainCore::ChunkFace> faces;
+	m_kernels->collectFaces(cells.GetData(), lod, skirts, TerrainCore::AllSolidTypes, ChunkSize, faces);
+	vertices.Reserve(faces.size() * 4);
+	indices.Reserve(faces.size() * 6);
+	for (const TerrainCore::ChunkFace& face : faces) {
+		const uint32 first = vertices.Num();
+		for (size_t i = 0; i < 4; ++i) {
+			const int32* corner = corners[faceVertices[face.dir][i]];
+			vertices.Add(PackVoxelVertex(
+				(face.x << lod) + corner[0] * size,
+				(face.y << lod) + corner[1] * size,
+				(face.z << lod) + corner[2] * size,
+				face.dir, face.type - 2));
 		}
+		for (size_t i = 0; i < 6; ++i)
+			indices.Add(first + faceIndices[face.dir][i]);
 	}
 }
@@ -18,11 +18,22 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "TerrainCore/TerrainCore.h"
+#include "TerrainFlightRecorder.h"
 #include "Terrain.generated.h"
 
 class UProceduralMeshComponent;
+class UVoxelChunkComponent;
 class UMaterial;
 
+UENUM()
+enum class ETerrainCollisionMode : uint8 {
+	// Chunk triangles used as collision
+	Mesh,
+	// Merged boxes over surface exposed voxels
+	MergedBoxes
+};
+
 
 UCLASS()
 class FRACTALTERRAINV2_API ATerrain : public AActor
@@ -38,11 +49,18 @@ public:
 		FRONT,
 		BACK
 	};
+
 	// Sets default values for this actor's properties
 	ATerrain();
 
 	/*
-		Performs collision testing on the terrain
+		Writes the flight recorder frames, player position and queued chunks
+		to Saved/TerrainHitches. Returns the CSV path.
+	*/
+	FString DumpFlightRecorder(const FString& reason);
+
+	/*
+		Performs collision testing on the terrain voxels
 	*/
 	UFUNCTION(BlueprintCallable, Category = "Terrain")
 	bool Raycast(const FVector& start, const FVector& end, FIntVector& blockCoords, FVector &coords);
@@ -53,12 +71,166 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Terrain")
 	float PopBlock(const FIntVector &coords);
 
+	/*
+		Region edits. Carve replaces voxels by air, Fill by given block type.
+		Both return a histogram (block type -> count) of the solid blocks
+		they replaced, and remesh each affected chunk once.
+		Columns go from top down, depth blocks deep, and edit nothing when
+		depth is below 1.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> CarveBox(const FIntVector& min, const FIntVector& max);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> CarveSphere(const FIntVector& center, int32 radius);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> CarveColumn(const FIntVector& top, int32 depth);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> FillBox(const FIntVector& min, const FIntVector& max, int32 type);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> FillSphere(const FIntVector& center, int32 radius, int32 type);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> FillColumn(const FIntVector& top, int32 depth, int32 type);
+
+	/*
+		Returns a histogram (block type -> count) of the solid blocks in the
+		box [min, max], generating its chunks first.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TMap<int32, int32> CountMaterials(const FIntVector& min, const FIntVector& max);
+
+	/*
+		Sets a block in the terrain and remesh, returns the replaced block type
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	float PlaceBlock(const FIntVector& coord, int type);
+
+	/*
+		Returns the height of the top solid voxel of column (x, y), among
+		generated chunks. Returns false if the column is unknown or empty.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	bool GetSurfaceHeight(int32 x, int32 y, int32& height) const;
+
+	/*
+		Intersects a ray with the surface height index only. Fails if the ray
+		starts under the surface, or crosses a column not generated yet.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	bool RaycastSurface(const FVector& start, const FVector& end, FIntVector& blockCoords) const;
+
 	/*
 		Returns the block type at given coordinates
 	*/
 	UFUNCTION(BlueprintCallable, Category = "Terrain")
 	int GetBlockType(const FIntVector& coord);
 
+	/*
+		Returns whether a solid voxel overlaps given world space box
+	*/
+	bool OverlapsSolid(const FBox& box) const;
+
+	/*
+		Returns whether a cell held by a machine overlaps given world space box
+	*/
+	bool OverlapsOccupied(const FBox& box) const;
+
+	/*
+		Returns whether the chunk containing given world location is generated
+	*/
+	bool IsGenerated(const FVector& location) const;
+
+	/*
+		Returns whether every chunk given world space box overlaps is generated
+	*/
+	bool IsGenerated(const FBox& box) const;
+
+	/*
+		Returns block types of the box [min, max], X first then Y then Z
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TArray<int32> GetBlockTypes(const FIntVector& min, const FIntVector& max);
+
+	/*
+		Returns block types at each given coordinates, in the same order
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	TArray<int32> GetBlockTypesAt(const TArray<FIntVector>& coords);
+
+	/*
+		Registers a chunk load ticket following the given actor. Every chunk
+		within radius (in chunks) of the actor stays resident until the ticket
+		is removed. Higher priority tickets get their chunks loaded first.
+		Returns the ticket handle.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	int32 AddChunkTicket(AActor* owner, int32 radius, int32 priority);
+
+	/*
+		Same as AddChunkTicket, but for a fixed chunk coordinate.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	int32 AddStaticChunkTicket(const FIntVector& chunkCoords, int32 radius, int32 priority);
+
+	/*
+		Releases a ticket, chunks no longer referenced by any ticket are unloaded.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	void RemoveChunkTicket(int32 ticket);
+
+	/*
+		Chunk radius LodRanges reach, beyond it chunks are only resident when
+		a ticket holds them. View tickets use it to load the coarse LODs.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	int32 GetViewRadius() const;
+
+	/*
+		Returns whether the chunk at given chunk coordinates is held by a ticket.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain")
+	bool IsChunkResident(const FIntVector& chunkCoords) const;
+
+	/*
+		Occupancy of placed machines. A machine holds the voxel cells its
+		bounds cover, under a handle, until removed or until it ends play.
+		Returns the handle, -1 if a cell is already held.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain|Occupancy")
+	int32 AddOccupant(AActor* actor);
+
+	int32 AddOccupant(AActor* actor, const FIntVector& min, const FIntVector& max);
+
+	UFUNCTION(BlueprintCallable, Category = "Terrain|Occupancy")
+	void RemoveOccupant(int32 handle);
+
+	// Returns whether the actor holds cells
+	bool IsOccupant(const AActor* actor) const;
+
+	/*
+		Voxel cells covered by a world space box, faces merely touching a
+		cell do not cover it.
+	*/
+	void GetBoxCells(const FBox& box, FIntVector& min, FIntVector& max) const;
+
+	// Returns whether a machine holds a cell of the box [min, max]
+	bool IsOccupied(const FIntVector& min, const FIntVector& max) const;
+
+	// Machine holding cell, nullptr if none
+	UFUNCTION(BlueprintCallable, Category = "Terrain|Occupancy")
+	AActor* GetOccupant(const FIntVector& cell) const;
+
+	/*
+		Returns the first machine along the segment, nullptr if the segment
+		ends or hits a solid voxel first.
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Terrain|Occupancy")
+	AActor* RaycastOccupant(const FVector& start, const FVector& end);
+
 	/*
 		Returns chunk index at given chunk coordinates
 	*/
@@ -84,8 +256,23 @@ public:
 			std::floor(z / m_chunkWorldSize));
 	};
 
+	/*
+		Given voxel coordinates, returns coordinates of the chunk containing it.
+	*/
+	FIntVector voxelToChunkCoords(const FIntVector& voxel) const {
+		// Arithmetic shift floors negative coordinates too
+		if (m_chunkShift >= 0)
+			return FIntVector(voxel.X >> m_chunkShift, voxel.Y >> m_chunkShift, voxel.Z >> m_chunkShift);
+		return FIntVector(
+			std::floor(voxel.X / static_cast<float>(ChunkSize)),
+			std::floor(voxel.Y / static_cast<float>(ChunkSize)),
+			std::floor(voxel.Z / static_cast<float>(ChunkSize)));
+	};
+
+	void generateChunk(int64 index);
 	void preloadChunk(int64 index);
 	void loadChunk(int64 index);
+	void unloadChunk(int64 index);
 
 	/*
 		Returns the world coordinate in the middle of the block given face.
@@ -110,28 +297,214 @@ protected:
 
 	UProceduralMeshComponent *getChunk(uint64 index);
 
+	struct ChunkTicket {
+		TWeakObjectPtr<AActor> owner;
+		FIntVector center;
+		int32 radius;
+		int32 priority;
+		bool isStatic;
+	};
+
+	struct PendingLoad {
+		int32 priority;
+		// Shell index around the closest ticket center
+		int32 distance;
+	};
+
+	int32 addTicket(const ChunkTicket& ticket);
+	void acquireChunks(const ChunkTicket& ticket);
+	void releaseChunks(const ChunkTicket& ticket);
+	void updateTickets();
+	void processPendingLoads(int32 budget);
+
+	static const int32 NoSurface = MIN_int32;
+
+	// Top solid voxel of each (x, y) in a chunk column, X major
+	struct SurfaceColumn {
+		TArray<int32> heights;
+		int32 minChunkZ;
+	};
+
+	SurfaceColumn& getSurfaceColumn(const FIntVector& chunkCoords);
+	void addToSurface(int32 x, int32 y, int32 top);
+	// Rescans column (x, y) if its top lies within the removed [bottom, top] span
+	void removeFromSurface(int32 x, int32 y, int32 bottom, int32 top);
+
+	TMap<int32, int32> editBox(const FIntVector& min, const FIntVector& max, int32 type);
+	TMap<int32, int32> editSphere(const FIntVector& center, int32 radius, int32 type);
+	void editSpan(const openvdb::CoordBBox& bbox, int32 type, TMap<int32, int32>& removed);
+
+	/*
+		Adds solid blocks within bbox to histogram, reading leaf nodes and
+		tiles directly rather than voxel by voxel through the tree.
+	*/
+	void countMaterials(const openvdb::CoordBBox& bbox, TMap<int32, int32>& histogram) const;
+
+	void generateRegion(const openvdb::CoordBBox& bbox);
+	void markRegionDirty(const openvdb::CoordBBox& bbox);
+
+	/*
+		Flags chunks containing or touching given voxel for remeshing.
+	*/
+	void markVoxelDirty(const FIntVector& coord);
+
+	/*
+		Generates the chunk column at (x, y) top down until a solid voxel is found.
+	*/
+	bool findSpawnSurface(int32 x, int32 y, int32& surface);
+
+	struct ChunkLod {
+		uint8 lod;
+		// Faces (bit per direction) towards a neighbour of another LOD
+		uint8 skirts;
+	};
+
+	/*
+		Returns LOD of a chunk from its distance to the closest ticket.
+	*/
+	int32 computeChunkLod(const FIntVector& chunkCoords) const;
+	void updateLods();
+
+	/*
+		Samples the chunk into cells of 2^lod voxels, holding the majority
+		block type. Cells are X major with a one cell border taken from
+		neighbouring chunks.
+	*/
+	void buildCells(const FIntVector& chunkCoords, int32 lod, TArray<uint8>& cells) const;
+
+	/*
+		Adds faces of cells holding voxelType, or of every solid cell if
+		voxelType is TerrainCore::AllSolidTypes. When colors is given, each vertex gets its
+		material index (block type - 2) in the red channel.
+	*/
 	void processChunk(
-		const openvdb::CoordBBox& bbox, 
+		const TArray<uint8>& cells,
+		const FIntVector& chunkCoords,
+		int32 lod,
+		uint8 skirts,
 		TArray<FVector>& vertices,
 		TArray<int32>& triangles,
 		TArray<FVector>& normals,
-		int voxelType);
+		int voxelType,
+		TArray<FLinearColor>* colors = nullptr);
+
+	/*
+		Same faces as processChunk with TerrainCore::AllSolidTypes, as packed vertices
+		relative to the chunk origin.
+	*/
+	void processChunkPacked(
+		const TArray<uint8>& cells,
+		int32 lod,
+		uint8 skirts,
+		TArray<uint32>& vertices,
+		TArray<uint32>& indices);
+
+	// Shows or hides whichever component draws the chunk
+	void setChunkVisibility(int64 index, bool visible);
+
+	/*
+		Returns which pairs of chunk faces are linked through air, as 15 bits.
+	*/
+	uint16 computeConnectivity(const TArray<uint8>& cells, int32 lod) const;
+
+	/*
+		Finds chunks visible from the camera chunk through the connectivity
+		graph, hides the others and queues visible chunks not meshed yet.
+	*/
+	void updateVisibility();
+
+	/*
+		Covers solid voxels exposed to air with few axis aligned boxes, each
+		given as its 8 corners. Expects cells at full resolution (LOD 0).
+	*/
+	void buildCollisionBoxes(const TArray<uint8>& cells, const FIntVector& chunkCoords, TArray<TArray<FVector>>& boxes) const;
+
+	/*
+		Must be called after writing to the grid, as writes may delete
+		nodes held by the read accessor cache.
+	*/
+	void gridChanged() {
+		m_readAccessor->clear();
+		m_gridMemoryDirty = true;
+	}
+
+	struct ChunkMeshStats {
+		int32 vertices;
+		int32 triangles;
+	};
 
+	// Replaces the rendered geometry counted for a chunk
+	void setChunkMeshStats(int64 index, const ChunkMeshStats& stats);
 
 	//UProceduralMeshComponent *m_mesh;
 	openvdb::FloatGrid::Ptr m_grid;
 
+	struct Occupant {
+		TWeakObjectPtr<AActor> actor;
+		FIntVector min;
+		FIntVector max;
+	};
+
+	// Releases the cells of machines that did not remove themselves
+	UFUNCTION()
+	void handleOccupantEndPlay(AActor* actor, EEndPlayReason::Type reason);
+
+	// Machine handle of each held cell, next to the voxels of m_grid
+	TMap<FIntVector, int32> m_occupancy;
+	TMap<int32, Occupant> m_occupants;
+	int32 m_nextOccupant;
+
+	// Shared read accessor, keeps its node cache between queries
+	TUniquePtr<openvdb::FloatGrid::ConstAccessor> m_readAccessor;
+
 	TArray<int64> m_dirtyChunks;
 	TMap<int64, UProceduralMeshComponent*> m_chunks;
+	// Drawing components when packed meshes are in use
+	TMap<int64, UVoxelChunkComponent*> m_packedChunks;
+	bool m_packedMesh;
+	TSet<int64> m_generatedChunks;
+
+	// Surface height index, keyed by chunk column (z = 0)
+	TMap<int64, SurfaceColumn> m_surface;
+
+	// Residency is the union of all tickets, refcounted per chunk
+	TMap<int32, ChunkTicket> m_tickets;
+	TMap<int64, int32> m_chunkRefs;
+	TMap<int64, PendingLoad> m_pendingLoads;
+	int32 m_nextTicket;
+
+	TMap<int64, ChunkLod> m_chunkLods;
+	bool m_lodsDirty;
+
+	TMap<int64, ChunkMeshStats> m_chunkMeshStats;
+	int32 m_totalVertices;
+	int32 m_totalTriangles;
+	bool m_gridMemoryDirty;
+
+	TMap<int64, uint16> m_chunkConnectivity;
+	TSet<int64> m_visibleChunks;
+	// Chunks left unmeshed (or with a stale mesh) because hidden
+	TSet<int64> m_unmeshedChunks;
+	FIntVector m_cameraChunk;
+	bool m_visibilityDirty;
+	bool m_visibilityReady;
 
 
 	noise::module::Perlin m_groundNoiseModule;
 	noise::module::Perlin m_oreNoiseModule;
-	noise::utils::NoiseMap m_heightMap;
-	noise::utils::NoiseMapBuilderPlane m_heightMapBuilder;
 
 	float m_chunkWorldSize;
 
+	// Kernels for ChunkSize, chosen once at BeginPlay
+	const TerrainCore::ChunkKernels* m_kernels;
+	// log2(ChunkSize), -1 if not a power of two
+	int32 m_chunkShift;
+
+	double m_startupTime;
+
+	FTerrainFlightRecorder m_recorder;
+	double m_lastHitchDump;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -144,12 +517,56 @@ public:
 	UPROPERTY(EditAnywhere)
 	uint32 DbgChunkLoadRange;
 
+	// Maximum number of chunks meshed per frame for tickets
+	UPROPERTY(EditAnywhere)
+	int32 MaxChunkLoadsPerTick;
+
+	// Frames of terrain work kept for hitch reports
+	UPROPERTY(EditAnywhere, Category = "Terrain|Metrics")
+	int32 FlightRecorderFrames;
+
+	// Frames longer than this dump the flight recorder, 0 disables it
+	UPROPERTY(EditAnywhere, Category = "Terrain|Metrics")
+	float HitchThresholdMs;
+
+	// Chunk distance to the closest ticket up to which LOD i is used,
+	// farther chunks use 2^(i+1) voxel cells. The last range is the view
+	// radius players keep loaded.
+	UPROPERTY(EditAnywhere)
+	TArray<int32> LodRanges;
+
+	// Skip meshing and rendering of chunks the camera cannot see through air,
+	// only their collision is built
+	UPROPERTY(EditAnywhere)
+	bool bCullHiddenChunks;
+
 	UPROPERTY(EditAnywhere)
 	float HeightFactor;
 
+	UPROPERTY(EditAnywhere)
+	ETerrainCollisionMode CollisionMode;
+
+	// One mesh section per chunk for every block type, GroundMaterial then
+	// picks its texture array slice from vertex colour red (index / 255)
+	UPROPERTY(EditAnywhere)
+	bool bSingleMeshSection;
+
+	// Draw chunks from 32 bit packed vertices, needs ChunkSize <= 63.
+	// Collision then always uses merged boxes.
+	UPROPERTY(EditAnywhere)
+	bool bPackedChunkMesh;
+
 	UPROPERTY(EditAnywhere)
 	UMaterialInterface *GroundMaterial;
 
 	UPROPERTY(EditAnywhere)
 	UMaterialInterface *CoalOreMaterial;
+
+	// Milliseconds from BeginPlay to the first ticked frame
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Terrain|Metrics")
+	float TimeToFirstInteractiveFrame;
+
+	// Milliseconds from BeginPlay until every startup shell is loaded
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Terrain|Metrics")
+	float StartupLoadTime;
 };
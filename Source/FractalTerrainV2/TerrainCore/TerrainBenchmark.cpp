@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <random>
+
+namespace TerrainCore {
+
+static double Seconds() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<Int3> BenchmarkChunks(int32_t chunks) {
+	std::vector<Int3> coords;
+	for (int32_t i = 0; i < chunks; ++i)
+		coords.push_back({ i / 2, 0, (i % 2) - 1 });
+	return coords;
+}
+
+void GenerateBenchmarkChunks(const ChunkKernels& kernels, int32_t chunkSize, const std::vector<Int3>& chunks, openvdb::FloatGrid& grid) {
+	noise::module::Perlin groundNoise;
+	noise::module::Perlin oreNoise;
+	const int32_t columns = BenchmarkColumns(static_cast<int32_t>(chunks.size()));
+	std::vector<int32_t> columnTops(columns * chunkSize * chunkSize, INT_MIN);
+
+	for (const Int3& chunk : chunks) {
+		ChunkGenerationInput input;
+		input.grid = &grid;
+		input.groundNoise = &groundNoise;
+		input.oreNoise = &oreNoise;
+		input.heightFactor = 20.f;
+		input.chunkCoords = chunk;
+		input.columnTops = &columnTops[chunk.x * chunkSize * chunkSize];
+		kernels.generate(input, chunkSize);
+	}
+	grid.pruneGrid();
+}
+
+size_t MeshBenchmarkChunks(const ChunkKernels& kernels, int32_t chunkSize, const std::vector<Int3>& chunks, openvdb::FloatGrid::ConstAccessor& accessor) {
+	std::vector<uint8_t> cells(CellCount(chunkSize, 0));
+	std::vector<ChunkFace> faces;
+	size_t totalFaces = 0;
+	for (const Int3& chunk : chunks) {
+		faces.clear();
+		kernels.buildCells(accessor, chunk, 0, chunkSize, cells.data());
+		kernels.collectFaces(cells.data(), 0, 0, AllSolidTypes, chunkSize, faces);
+		kernels.computeConnectivity(cells.data(), 0, chunkSize);
+		totalFaces += faces.size();
+	}
+	return totalFaces;
+}
+
+int32_t CastBenchmarkRays(openvdb::FloatGrid::ConstAccessor& accessor, int32_t chunkSize, int32_t columns, int32_t raycasts) {
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> along(0.f, static_cast<float>(columns * chunkSize));
+	std::uniform_real_distribution<float> across(0.f, static_cast<float>(chunkSize));
+	std::uniform_real_distribution<float> spread(-8.f, 8.f);
+
+	int32_t hits = 0;
+	for (int32_t i = 0; i < raycasts; ++i) {
+		const float origin[3] = { along(random), across(random), static_cast<float>(chunkSize) };
+		const float dir[3] = { spread(random), spread(random), -2.f * chunkSize };
+		int32_t voxel[3];
+		float t;
+		hits += RaycastGrid(accessor, origin, dir, voxel, t) ? 1 : 0;
+	}
+	return hits;
+}
+
+BenchmarkResult RunBenchmark(const ChunkKernels& kernels, int32_t chunkSize, int32_t chunks, int32_t raycasts) {
+	chunks = std::max(chunks, 1);
+	raycasts = std::max(raycasts, 1);
+
+	openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create();
+	const std::vector<Int3> coords = BenchmarkChunks(chunks);
+
+	BenchmarkResult result;
+	result.chunkSize = chunkSize;
+
+	double start = Seconds();
+	GenerateBenchmarkChunks(kernels, chunkSize, coords, *grid);
+	result.chunksGeneratedPerSecond = chunks / std::max(Seconds() - start, 1e-9);
+
+	const double voxels = static_cast<double>(chunks) * chunkSize * chunkSize * chunkSize;
+	result.bytesPerVoxel = grid->memUsage() / voxels;
+
+	openvdb::FloatGrid::ConstAccessor accessor = grid->getConstAccessor();
+	start = Seconds();
+	const size_t totalFaces = MeshBenchmarkChunks(kernels, chunkSize, coords, accessor);
+	result.chunksMeshedPerSecond = chunks / std::max(Seconds() - start, 1e-9);
+	result.trianglesPerChunk = 2.0 * totalFaces / chunks;
+
+	start = Seconds();
+	CastBenchmarkRays(accessor, chunkSize, BenchmarkColumns(chunks), raycasts);
+	result.raycastsPerSecond = raycasts / std::max(Seconds() - start, 1e-9);
+
+	return result;
+}
+
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "TerrainCore.h"
+
+namespace TerrainCore {
+
+struct BenchmarkResult {
+	int32_t chunkSize;
+	double chunksGeneratedPerSecond;
+	// Cells, faces and connectivity, what loading a chunk costs before upload
+	double chunksMeshedPerSecond;
+	double trianglesPerChunk;
+	// Grid memory over the voxels of the generated chunks
+	double bytesPerVoxel;
+	double raycastsPerSecond;
+};
+
+/*
+	Chunk coordinates of the benchmark terrain: columns along X, two chunks
+	deep around the surface (z = -1 and 0).
+*/
+std::vector<Int3> BenchmarkChunks(int32_t chunks);
+
+// Number of chunk columns BenchmarkChunks spreads chunks over
+inline int32_t BenchmarkColumns(int32_t chunks) {
+	return (chunks + 1) / 2;
+}
+
+/*
+	Generates chunks into grid, then prunes it.
+*/
+void GenerateBenchmarkChunks(const ChunkKernels& kernels, int32_t chunkSize, const std::vector<Int3>& chunks, openvdb::FloatGrid& grid);
+
+/*
+	Builds cells, faces and connectivity of each chunk at LOD 0. Returns
+	the number of faces.
+*/
+size_t MeshBenchmarkChunks(const ChunkKernels& kernels, int32_t chunkSize, const std::vector<Int3>& chunks, openvdb::FloatGrid::ConstAccessor& accessor);
+
+/*
+	Casts rays from above the terrain going down at random angles, as when
+	mining. Returns the number of hits.
+*/
+int32_t CastBenchmarkRays(openvdb::FloatGrid::ConstAccessor& accessor, int32_t chunkSize, int32_t columns, int32_t raycasts);
+
+/*
+	Generates a block of chunks straddling the surface in a fresh grid, then
+	meshes them and casts rays into them. Deterministic for given arguments.
+*/
+BenchmarkResult RunBenchmark(const ChunkKernels& kernels, int32_t chunkSize, int32_t chunks, int32_t raycasts);
+
+}
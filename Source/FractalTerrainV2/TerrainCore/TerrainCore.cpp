@@ -0,0 +1,240 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainCore.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace TerrainCore {
+
+/*
+	Size is the chunk size, or 0 for the runtime sized fallback which reads
+	chunkSize instead. With a fixed Size every bound below is a constant.
+*/
+
+template<int32_t Size>
+static void GenerateChunk(const ChunkGenerationInput& input, int32_t chunkSize) {
+	const int32_t size = Size ? Size : chunkSize;
+	const Int3 origin = { input.chunkCoords.x * size, input.chunkCoords.y * size, input.chunkCoords.z * size };
+	const int32_t top = origin.z + size - 1;
+
+	// First fill with air
+	openvdb::FloatGrid& grid = *input.grid;
+	grid.fill(openvdb::CoordBBox(origin.x, origin.y, origin.z, origin.x + size - 1, origin.y + size - 1, top), 1.0, false);
+
+	for (int32_t j = 0; j < size; ++j) {
+		for (int32_t i = 0; i < size; ++i) {
+			const int32_t x = origin.x + i;
+			const int32_t y = origin.y + j;
+			const int32_t height = static_cast<int32_t>(input.groundNoise->GetValue(x / 128.0, y / 128.0, 0) * input.heightFactor);
+
+			if (height >= origin.z) {
+				int32_t& columnTop = input.columnTops[i + j * size];
+				columnTop = std::max(columnTop, std::min(height, top));
+			}
+
+			// Fill voxel grid
+			grid.fill(openvdb::CoordBBox(x, y, origin.z, x, y, std::min(height, top)), 2.0, true);
+
+			// Created after the fill, which may replace nodes an accessor would cache
+			openvdb::FloatGrid::Accessor accessor = grid.getAccessor();
+			// Ore stays within this chunk's ground, chunks are generated lazily
+			// and must not write into neighbours generated or edited already
+			for (int32_t k = origin.z; k <= std::min(height, top); ++k) {
+				if (input.oreNoise->GetValue(x / 32.0, y / 32.0, k / 32.0) > 0.5)
+					accessor.setValue(openvdb::Coord(x, y, k), 3.0);
+			}
+		}
+	}
+}
+
+template<int32_t Size>
+static void BuildCells(
+	openvdb::FloatGrid::ConstAccessor& accessor,
+	const Int3& chunkCoords,
+	int32_t lod,
+	int32_t chunkSize,
+	uint8_t* cells) {
+
+	const int32_t size = Size ? Size : chunkSize;
+	const int32_t cellSize = 1 << lod;
+	const int32_t dim = (size >> lod) + 2;
+	// Cell (0, 0, 0) lies in the neighbour chunks
+	const Int3 origin = { chunkCoords.x * size - cellSize, chunkCoords.y * size - cellSize, chunkCoords.z * size - cellSize };
+
+	uint8_t* cell = cells;
+	if (lod == 0) {
+		for (int32_t z = 0; z < dim; ++z)
+			for (int32_t y = 0; y < dim; ++y)
+				for (int32_t x = 0; x < dim; ++x)
+					*cell++ = static_cast<uint8_t>(accessor.getValue(openvdb::Coord(origin.x + x, origin.y + y, origin.z + z)));
+		return;
+	}
+
+	for (int32_t z = 0; z < dim; ++z) {
+		for (int32_t y = 0; y < dim; ++y) {
+			for (int32_t x = 0; x < dim; ++x) {
+				const openvdb::Coord base(origin.x + (x << lod), origin.y + (y << lod), origin.z + (z << lod));
+
+				// Majority block type of the cell, ties go to the higher type so
+				// thin solid layers survive downsampling
+				int32_t counts[MaxBlockTypes] = { 0 };
+				for (int32_t k = 0; k < cellSize; ++k)
+					for (int32_t j = 0; j < cellSize; ++j)
+						for (int32_t i = 0; i < cellSize; ++i) {
+							const int32_t value = static_cast<int32_t>(accessor.getValue(base.offsetBy(i, j, k)));
+							++counts[std::min(std::max(value, 0), MaxBlockTypes - 1)];
+						}
+
+				int32_t best = 0;
+				for (int32_t type = 1; type < MaxBlockTypes; ++type)
+					if (counts[type] >= counts[best])
+						best = type;
+				*cell++ = static_cast<uint8_t>(best);
+			}
+		}
+	}
+}
+
+template<int32_t Size>
+static void CollectFaces(
+	const uint8_t* cells,
+	int32_t lod,
+	uint8_t skirts,
+	int32_t voxelType,
+	int32_t chunkSize,
+	std::vector<ChunkFace>& faces) {
+
+	const int32_t n = (Size ? Size : chunkSize) >> lod;
+	const int32_t dim = n + 2;
+	const int32_t offsets[6] = { -1, 1, -dim, dim, -dim * dim, dim * dim };
+
+	for (int32_t z = 1; z <= n; ++z) {
+		for (int32_t y = 1; y <= n; ++y) {
+			for (int32_t x = 1; x <= n; ++x) {
+				const int32_t idx = x + (y + z * dim) * dim;
+				const uint8_t type = cells[idx];
+				if (voxelType == AllSolidTypes ? type <= 1 : type != voxelType)
+					continue;
+
+				const bool border[6] = { x == 1, x == n, y == 1, y == n, z == 1, z == n };
+				for (int32_t dir = 0; dir < 6; ++dir) {
+					// Faces towards a chunk of another LOD are always kept so
+					// they close the seam between both levels
+					if (1 == cells[idx + offsets[dir]] || (border[dir] && (skirts & (1 << dir)))) {
+						const ChunkFace face = {
+							static_cast<uint8_t>(x - 1),
+							static_cast<uint8_t>(y - 1),
+							static_cast<uint8_t>(z - 1),
+							static_cast<uint8_t>(dir),
+							type
+						};
+						faces.push_back(face);
+					}
+				}
+			}
+		}
+	}
+}
+
+template<int32_t Size>
+static uint16_t ComputeConnectivity(const uint8_t* cells, int32_t lod, int32_t chunkSize) {
+	const int32_t n = (Size ? Size : chunkSize) >> lod;
+	const int32_t dim = n + 2;
+	const int32_t offsets[6] = { -1, 1, -dim, dim, -dim * dim, dim * dim };
+
+	std::vector<uint8_t> visited(dim * dim * dim, 0);
+	std::vector<int32_t> stack;
+	uint16_t connectivity = 0;
+
+	// Flood fill each air region, faces it touches are connected to each other
+	for (int32_t z = 1; z <= n; ++z) {
+		for (int32_t y = 1; y <= n; ++y) {
+			for (int32_t x = 1; x <= n; ++x) {
+				const int32_t start = x + (y + z * dim) * dim;
+				if (cells[start] != 1 || visited[start])
+					continue;
+
+				uint8_t faces = 0;
+				visited[start] = 1;
+				stack.push_back(start);
+				while (!stack.empty()) {
+					const int32_t idx = stack.back();
+					stack.pop_back();
+					const int32_t cx = idx % dim;
+					const int32_t cy = (idx / dim) % dim;
+					const int32_t cz = idx / (dim * dim);
+					const bool border[6] = { cx == 1, cx == n, cy == 1, cy == n, cz == 1, cz == n };
+
+					for (int32_t dir = 0; dir < 6; ++dir) {
+						if (border[dir]) {
+							faces |= 1 << dir;
+							continue;
+						}
+						const int32_t next = idx + offsets[dir];
+						if (cells[next] == 1 && !visited[next]) {
+							visited[next] = 1;
+							stack.push_back(next);
+						}
+					}
+				}
+
+				for (int32_t a = 0; a < 6; ++a)
+					for (int32_t b = a + 1; b < 6; ++b)
+						if ((faces & (1 << a)) && (faces & (1 << b)))
+							connectivity |= 1 << FacePairBit(a, b);
+			}
+		}
+	}
+	return connectivity;
+}
+
+template<int32_t Size>
+static ChunkKernels MakeKernels() {
+	ChunkKernels kernels;
+	kernels.chunkSize = Size;
+	kernels.generate = &GenerateChunk<Size>;
+	kernels.buildCells = &BuildCells<Size>;
+	kernels.collectFaces = &CollectFaces<Size>;
+	kernels.computeConnectivity = &ComputeConnectivity<Size>;
+	return kernels;
+}
+
+// Instantiated for the supported sizes only
+static const ChunkKernels Kernels16 = MakeKernels<16>();
+static const ChunkKernels Kernels32 = MakeKernels<32>();
+static const ChunkKernels Kernels64 = MakeKernels<64>();
+static const ChunkKernels KernelsRuntime = MakeKernels<0>();
+
+const ChunkKernels* SelectChunkKernels(int32_t chunkSize) {
+	switch (chunkSize) {
+	case 16:
+		return &Kernels16;
+	case 32:
+		return &Kernels32;
+	case 64:
+		return &Kernels64;
+	default:
+		// Face coordinates are stored on 8 bits
+		return chunkSize > 0 && chunkSize <= 255 ? &KernelsRuntime : nullptr;
+	}
+}
+
+const ChunkKernels& RuntimeChunkKernels() {
+	return KernelsRuntime;
+}
+
+bool RaycastGrid(
+	openvdb::FloatGrid::ConstAccessor& accessor,
+	const float origin[3],
+	const float dir[3],
+	int32_t voxel[3],
+	float& t) {
+
+	return WalkGrid(origin, dir, voxel, t, [&accessor](const int32_t* v) {
+		return accessor.getValue(openvdb::Coord(v[0], v[1], v[2])) > 1;
+	});
+}
+
+}
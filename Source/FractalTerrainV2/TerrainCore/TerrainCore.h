@@ -0,0 +1,177 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*
+	Engine independent terrain core: chunk generation, meshing kernels and
+	grid raycasts. Only depends on OpenVDB, libnoise and the standard
+	library, so it can be built and profiled outside of the editor: see
+	CMakeLists.txt for the static library and its Google Benchmark suite.
+	ATerrain drives it.
+*/
+
+#ifdef _MSC_VER
+#pragma warning ( push )
+#pragma warning ( disable: 4668 )
+#pragma warning ( disable: 4211 )
+#pragma warning ( disable: 4146 )
+#endif
+
+#include <openvdb/openvdb.h>
+
+#include <noise/noise.h>
+
+#ifdef _MSC_VER
+#pragma warning ( pop )
+#endif
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace TerrainCore {
+
+/*
+	Grid values are block types: 0 not generated, 1 air, 2 ground, 3 coal.
+	Anything above 1 is solid.
+*/
+
+// Block values tracked when downsampling, higher values are clamped
+const int32_t MaxBlockTypes = 8;
+
+// Voxel type selecting every solid block when collecting faces
+const int32_t AllSolidTypes = 0;
+
+struct Int3 {
+	int32_t x, y, z;
+};
+
+/*
+	Visible face of a cell, coordinates in cells from the chunk origin.
+	Direction follows the chunk neighbour order (-X, +X, -Y, +Y, -Z, +Z).
+*/
+struct ChunkFace {
+	uint8_t x, y, z;
+	uint8_t dir;
+	uint8_t type;
+};
+
+struct ChunkGenerationInput {
+	openvdb::FloatGrid* grid;
+	const noise::module::Perlin* groundNoise;
+	const noise::module::Perlin* oreNoise;
+	float heightFactor;
+	Int3 chunkCoords;
+	// size * size column tops, X major, raised to the ground level found
+	int32_t* columnTops;
+};
+
+/*
+	Cells are the block types of a chunk at some LOD, (n + 2)^3 X major with
+	a one cell border from neighbouring chunks, n = chunk size >> lod.
+*/
+inline int32_t CellCount(int32_t chunkSize, int32_t lod) {
+	const int32_t dim = (chunkSize >> lod) + 2;
+	return dim * dim * dim;
+}
+
+/*
+	One set of kernels per chunk size, compiled for fixed sizes so bounds are
+	constants and index math becomes shifts. chunkSize arguments are only
+	read by the runtime sized set.
+*/
+struct ChunkKernels {
+	int32_t chunkSize;
+
+	// Fills the chunk with air, ground and ore, writing no voxel outside it.
+	// Grid is not pruned.
+	void (*generate)(const ChunkGenerationInput& input, int32_t chunkSize);
+
+	// Writes CellCount(chunkSize, lod) cells
+	void (*buildCells)(
+		openvdb::FloatGrid::ConstAccessor& accessor,
+		const Int3& chunkCoords,
+		int32_t lod,
+		int32_t chunkSize,
+		uint8_t* cells);
+
+	// Faces of cells of voxelType (or AllSolidTypes) facing air or a skirt
+	void (*collectFaces)(
+		const uint8_t* cells,
+		int32_t lod,
+		uint8_t skirts,
+		int32_t voxelType,
+		int32_t chunkSize,
+		std::vector<ChunkFace>& faces);
+
+	// Pairs of chunk faces linked through air, 15 bits, see FacePairBit
+	uint16_t (*computeConnectivity)(const uint8_t* cells, int32_t lod, int32_t chunkSize);
+};
+
+/*
+	Bit of the (a, b) face pair in a 15 bit connectivity mask.
+*/
+inline int32_t FacePairBit(int32_t a, int32_t b) {
+	if (a > b) {
+		const int32_t swap = a;
+		a = b;
+		b = swap;
+	}
+	return a * (11 - a) / 2 + (b - a - 1);
+}
+
+/*
+	Kernels specialised for 16, 32 or 64, runtime sized ones otherwise.
+	Returns nullptr for sizes cells cannot index (above 255).
+*/
+const ChunkKernels* SelectChunkKernels(int32_t chunkSize);
+
+// Runtime sized kernels, for comparison with the specialised ones
+const ChunkKernels& RuntimeChunkKernels();
+
+/*
+	Walks voxels from origin along dir up to t = 1 (Amanatides & Woo), both in
+	voxel units, until stop(voxel) returns true. Returns whether it did, with
+	that voxel and the t it is entered at.
+*/
+template<typename Stop>
+bool WalkGrid(const float origin[3], const float dir[3], int32_t voxel[3], float& t, Stop&& stop) {
+	const float infinity = 1e30f;
+	int32_t step[3];
+	float tDelta[3];
+	float tMax[3];
+	for (int32_t axis = 0; axis < 3; ++axis) {
+		voxel[axis] = static_cast<int32_t>(std::floor(origin[axis]));
+		step[axis] = dir[axis] > 0 ? 1 : -1;
+		tDelta[axis] = dir[axis] != 0 ? std::fabs(1.f / dir[axis]) : infinity;
+		tMax[axis] = dir[axis] != 0
+			? (dir[axis] > 0 ? voxel[axis] + 1 - origin[axis] : origin[axis] - voxel[axis]) * tDelta[axis]
+			: infinity;
+	}
+
+	t = 0;
+	while (t <= 1.f) {
+		if (stop(static_cast<const int32_t*>(voxel)))
+			return true;
+
+		const int32_t axis = tMax[0] < tMax[1]
+			? (tMax[0] < tMax[2] ? 0 : 2)
+			: (tMax[1] < tMax[2] ? 1 : 2);
+		t = tMax[axis];
+		voxel[axis] += step[axis];
+		tMax[axis] += tDelta[axis];
+	}
+	return false;
+}
+
+/*
+	Walks the grid as WalkGrid, returns true with the first solid voxel.
+*/
+bool RaycastGrid(
+	openvdb::FloatGrid::ConstAccessor& accessor,
+	const float origin[3],
+	const float dir[3],
+	int32_t voxel[3],
+	float& t);
+
+}
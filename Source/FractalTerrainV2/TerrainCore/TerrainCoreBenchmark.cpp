@@ -0,0 +1,92 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+/*
+	Google Benchmark suite of the terrain core, built by CMakeLists.txt
+	outside of the engine. The game module compiles this file to nothing.
+*/
+
+#if TERRAIN_CORE_STANDALONE
+
+#include "TerrainBenchmark.h"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+const int32_t BenchmarkChunkCount = 16;
+const int32_t BenchmarkRaycasts = 10000;
+
+// Arguments are chunk size, then 1 for the runtime sized kernels
+const TerrainCore::ChunkKernels& Kernels(const benchmark::State& state) {
+	const int32_t size = static_cast<int32_t>(state.range(0));
+	return state.range(1) ? TerrainCore::RuntimeChunkKernels() : *TerrainCore::SelectChunkKernels(size);
+}
+
+openvdb::FloatGrid::Ptr GenerateGrid(const benchmark::State& state, const std::vector<TerrainCore::Int3>& chunks) {
+	openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create();
+	TerrainCore::GenerateBenchmarkChunks(Kernels(state), static_cast<int32_t>(state.range(0)), chunks, *grid);
+	return grid;
+}
+
+void GenerateChunks(benchmark::State& state) {
+	const int32_t size = static_cast<int32_t>(state.range(0));
+	const std::vector<TerrainCore::Int3> chunks = TerrainCore::BenchmarkChunks(BenchmarkChunkCount);
+
+	double bytes = 0;
+	for (auto _ : state) {
+		openvdb::FloatGrid::Ptr grid = GenerateGrid(state, chunks);
+		state.PauseTiming();
+		bytes = static_cast<double>(grid->memUsage());
+		grid.reset();
+		state.ResumeTiming();
+	}
+
+	const double voxels = static_cast<double>(BenchmarkChunkCount) * size * size * size;
+	state.counters["chunks_generated/s"] = benchmark::Counter(BenchmarkChunkCount, benchmark::Counter::kIsIterationInvariantRate);
+	state.counters["bytes/voxel"] = bytes / voxels;
+}
+
+void MeshChunks(benchmark::State& state) {
+	const int32_t size = static_cast<int32_t>(state.range(0));
+	const std::vector<TerrainCore::Int3> chunks = TerrainCore::BenchmarkChunks(BenchmarkChunkCount);
+	openvdb::FloatGrid::Ptr grid = GenerateGrid(state, chunks);
+	openvdb::FloatGrid::ConstAccessor accessor = grid->getConstAccessor();
+
+	size_t faces = 0;
+	for (auto _ : state)
+		benchmark::DoNotOptimize(faces = TerrainCore::MeshBenchmarkChunks(Kernels(state), size, chunks, accessor));
+
+	state.counters["chunks_meshed/s"] = benchmark::Counter(BenchmarkChunkCount, benchmark::Counter::kIsIterationInvariantRate);
+	state.counters["triangles/chunk"] = 2.0 * faces / BenchmarkChunkCount;
+}
+
+void Raycast(benchmark::State& state) {
+	const int32_t size = static_cast<int32_t>(state.range(0));
+	const std::vector<TerrainCore::Int3> chunks = TerrainCore::BenchmarkChunks(BenchmarkChunkCount);
+	openvdb::FloatGrid::Ptr grid = GenerateGrid(state, chunks);
+	openvdb::FloatGrid::ConstAccessor accessor = grid->getConstAccessor();
+
+	for (auto _ : state)
+		benchmark::DoNotOptimize(TerrainCore::CastBenchmarkRays(
+			accessor, size, TerrainCore::BenchmarkColumns(BenchmarkChunkCount), BenchmarkRaycasts));
+
+	state.counters["raycasts/s"] = benchmark::Counter(BenchmarkRaycasts, benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void ChunkSizes(benchmark::internal::Benchmark* benchmark) {
+	benchmark->ArgNames({ "size", "runtime" });
+	for (const int64_t size : { 16, 32, 64 })
+		for (const int64_t runtime : { 0, 1 })
+			benchmark->Args({ size, runtime });
+	benchmark->Unit(benchmark::kMillisecond);
+}
+
+}
+
+BENCHMARK(GenerateChunks)->Apply(ChunkSizes);
+BENCHMARK(MeshChunks)->Apply(ChunkSizes);
+BENCHMARK(Raycast)->Apply(ChunkSizes);
+
+BENCHMARK_MAIN();
+
+#endif
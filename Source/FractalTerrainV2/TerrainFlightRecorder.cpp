@@ -0,0 +1,60 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TerrainFlightRecorder.h"
+
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+FTerrainFlightRecorder::FTerrainFlightRecorder() :
+	m_head(0),
+	m_count(0)
+{
+	FMemory::Memzero(m_current);
+}
+
+void FTerrainFlightRecorder::SetCapacity(int32 frames) {
+	m_frames.SetNumZeroed(FMath::Max(frames, 1));
+	m_head = 0;
+	m_count = 0;
+}
+
+void FTerrainFlightRecorder::EndFrame(uint64 frame, float frameMs) {
+	if (m_frames.Num() == 0)
+		SetCapacity(1);
+
+	m_current.frame = frame;
+	m_current.frameMs = frameMs;
+	m_frames[m_head] = m_current;
+	m_head = (m_head + 1) % m_frames.Num();
+	m_count = FMath::Min(m_count + 1, m_frames.Num());
+
+	FMemory::Memzero(m_current);
+}
+
+FString FTerrainFlightRecorder::Dump(const FString& reason, const TArray<FString>& context) const {
+	FString csv;
+	csv += FString::Printf(TEXT("# Reason,%s\n"), *reason);
+	for (const FString& line : context)
+		csv += FString::Printf(TEXT("# %s\n"), *line);
+
+	csv += TEXT("Frame,FrameMs,ChunksGenerated,ChunksMeshed,ChunksUploaded,GenerateMs,MeshMs,UploadMs,CollisionMs,PendingLoads,DirtyChunks\n");
+	const int32 first = (m_head - m_count + m_frames.Num()) % FMath::Max(m_frames.Num(), 1);
+	for (int32 i = 0; i < m_count; ++i) {
+		const FTerrainFrameRecord& record = m_frames[(first + i) % m_frames.Num()];
+		csv += FString::Printf(TEXT("%llu,%.3f,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%d,%d\n"),
+			record.frame, record.frameMs,
+			record.chunksGenerated, record.chunksMeshed, record.chunksUploaded,
+			record.generateMs, record.meshMs, record.uploadMs, record.collisionMs,
+			record.pendingLoads, record.dirtyChunks);
+	}
+
+	const FString path = FPaths::Combine(
+		FPaths::ProjectSavedDir(),
+		TEXT("TerrainHitches"),
+		FString::Printf(TEXT("Hitch_%s.csv"), *FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S_%s"))));
+	if (!FFileHelper::SaveStringToFile(csv, *path))
+		return FString();
+	return path;
+}
@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+	Terrain work done during one frame.
+*/
+struct FTerrainFrameRecord {
+	uint64 frame;
+	// Duration of the whole frame, game thread delta
+	float frameMs;
+
+	int32 chunksGenerated;
+	int32 chunksMeshed;
+	// Mesh sections and packed meshes sent, a chunk may send several
+	int32 chunksUploaded;
+	float generateMs;
+	float meshMs;
+	float uploadMs;
+	float collisionMs;
+
+	int32 pendingLoads;
+	int32 dirtyChunks;
+};
+
+/*
+	Keeps the last frames of terrain work in a ring buffer, so the frames
+	leading to a hitch can be written out after it happened.
+*/
+class FTerrainFlightRecorder {
+public:
+	FTerrainFlightRecorder();
+
+	void SetCapacity(int32 frames);
+
+	/*
+		Work of the frame being recorded, timers add to it.
+	*/
+	FTerrainFrameRecord& Current() {
+		return m_current;
+	}
+
+	/*
+		Closes the current frame with its duration and starts the next one.
+	*/
+	void EndFrame(uint64 frame, float frameMs);
+
+	/*
+		Writes recorded frames, oldest first, to Saved/TerrainHitches as CSV.
+		context lines are written first as comments. Returns the file path,
+		empty if writing failed.
+	*/
+	FString Dump(const FString& reason, const TArray<FString>& context) const;
+
+private:
+	TArray<FTerrainFrameRecord> m_frames;
+	// Next slot to write
+	int32 m_head;
+	int32 m_count;
+	FTerrainFrameRecord m_current;
+};
+
+/*
+	Adds the time spent in its scope to a record field, in milliseconds.
+*/
+class FTerrainRecorderScope {
+public:
+	explicit FTerrainRecorderScope(float& ms) :
+		m_ms(ms),
+		m_start(FPlatformTime::Cycles64())
+	{}
+
+	~FTerrainRecorderScope() {
+		m_ms += static_cast<float>(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - m_start));
+	}
+
+private:
+	float& m_ms;
+	uint64 m_start;
+};
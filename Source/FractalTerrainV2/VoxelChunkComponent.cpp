@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelChunkComponent.h"
+
+#include "PrimitiveSceneProxy.h"
+#include "SceneManagement.h"
+#include "Materials/Material.h"
+#include "Engine/Engine.h"
+
+class FVoxelChunkSceneProxy final : public FPrimitiveSceneProxy {
+public:
+	FVoxelChunkSceneProxy(UVoxelChunkComponent* component) :
+		FPrimitiveSceneProxy(component),
+		m_vertexFactory(GetScene().GetFeatureLevel()),
+		m_materialRelevance(component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+	{
+		m_vertexBuffer.Vertices = component->m_vertices;
+		m_indexBuffer.Indices = component->m_indices;
+		m_vertexFactory.SetVertexBuffer(&m_vertexBuffer);
+
+		m_material = component->GetMaterial(0);
+		if (!m_material)
+			m_material = UMaterial::GetDefaultMaterial(MD_Surface);
+
+		FVoxelChunkSceneProxy* proxy = this;
+		ENQUEUE_RENDER_COMMAND(InitVoxelChunkProxy)(
+			[proxy](FRHICommandListImmediate& RHICmdList) {
+				proxy->m_vertexBuffer.InitResource();
+				proxy->m_indexBuffer.InitResource();
+				proxy->m_vertexFactory.InitResource();
+			});
+	}
+
+	virtual ~FVoxelChunkSceneProxy() {
+		m_vertexBuffer.ReleaseResource();
+		m_indexBuffer.ReleaseResource();
+		m_vertexFactory.ReleaseResource();
+	}
+
+	virtual SIZE_T GetTypeHash() const override {
+		static size_t uniquePointer;
+		return reinterpret_cast<size_t>(&uniquePointer);
+	}
+
+	virtual void GetDynamicMeshElements(
+		const TArray<const FSceneView*>& Views,
+		const FSceneViewFamily& ViewFamily,
+		uint32 VisibilityMap,
+		FMeshElementCollector& Collector) const override {
+
+		for (int32 viewIndex = 0; viewIndex < Views.Num(); ++viewIndex) {
+			if (!(VisibilityMap & (1 << viewIndex)))
+				continue;
+
+			FMeshBatch& mesh = Collector.AllocateMesh();
+			mesh.VertexFactory = &m_vertexFactory;
+			mesh.MaterialRenderProxy = m_material->GetRenderProxy();
+			mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+			mesh.Type = PT_TriangleList;
+			mesh.DepthPriorityGroup = SDPG_World;
+			mesh.bCanApplyViewModeOverrides = false;
+
+			FMeshBatchElement& element = mesh.Elements[0];
+			element.IndexBuffer = &m_indexBuffer;
+			element.PrimitiveUniformBuffer = GetUniformBuffer();
+			element.FirstIndex = 0;
+			element.NumPrimitives = m_indexBuffer.Indices.Num() / 3;
+			element.MinVertexIndex = 0;
+			element.MaxVertexIndex = m_vertexBuffer.Vertices.Num() - 1;
+
+			Collector.AddMesh(viewIndex, mesh);
+		}
+	}
+
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override {
+		FPrimitiveViewRelevance result;
+		result.bDrawRelevance = IsShown(View);
+		result.bShadowRelevance = IsShadowCast(View);
+		result.bDynamicRelevance = true;
+		result.bRenderInMainPass = ShouldRenderInMainPass();
+		result.bRenderCustomDepth = ShouldRenderCustomDepth();
+		m_materialRelevance.SetPrimitiveViewRelevance(result);
+		return result;
+	}
+
+	virtual bool CanBeOccluded() const override {
+		return !m_materialRelevance.bDisableDepthTest;
+	}
+
+	virtual uint32 GetMemoryFootprint() const override {
+		return sizeof(*this) + GetAllocatedSize();
+	}
+
+	uint32 GetAllocatedSize() const {
+		return FPrimitiveSceneProxy::GetAllocatedSize()
+			+ m_vertexBuffer.Vertices.GetAllocatedSize()
+			+ m_indexBuffer.Indices.GetAllocatedSize();
+	}
+
+private:
+	FVoxelChunkVertexBuffer m_vertexBuffer;
+	FVoxelChunkIndexBuffer m_indexBuffer;
+	FVoxelChunkVertexFactory m_vertexFactory;
+	UMaterialInterface* m_material;
+	FMaterialRelevance m_materialRelevance;
+};
+
+UVoxelChunkComponent::UVoxelChunkComponent() :
+	m_localBounds(ForceInit)
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+}
+
+void UVoxelChunkComponent::SetMesh(TArray<FVoxelPackedVertex>& vertices, TArray<uint32>& indices) {
+	m_vertices = MoveTemp(vertices);
+	m_indices = MoveTemp(indices);
+
+	m_localBounds.Init();
+	for (const FVoxelPackedVertex vertex : m_vertices)
+		m_localBounds += FVector(vertex & 63, (vertex >> 6) & 63, (vertex >> 12) & 63);
+
+	UpdateBounds();
+	MarkRenderStateDirty();
+}
+
+FPrimitiveSceneProxy* UVoxelChunkComponent::CreateSceneProxy() {
+	if (m_indices.Num() == 0)
+		return nullptr;
+	return new FVoxelChunkSceneProxy(this);
+}
+
+int32 UVoxelChunkComponent::GetNumMaterials() const {
+	return 1;
+}
+
+FBoxSphereBounds UVoxelChunkComponent::CalcBounds(const FTransform& LocalToWorld) const {
+	if (!m_localBounds.IsValid)
+		return FBoxSphereBounds(LocalToWorld.GetLocation(), FVector::ZeroVector, 0.f);
+	return FBoxSphereBounds(m_localBounds).TransformBy(LocalToWorld);
+}
@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/MeshComponent.h"
+#include "VoxelChunkVertexFactory.h"
+#include "VoxelChunkComponent.generated.h"
+
+/**
+	Renders one chunk from packed 32 bit vertices (see FVoxelPackedVertex),
+	about 6 times less vertex memory than a procedural mesh section.
+	Display only, the chunk's procedural mesh holds its collision boxes.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API UVoxelChunkComponent : public UMeshComponent
+{
+	GENERATED_BODY()
+
+public:
+	UVoxelChunkComponent();
+
+	/*
+		Replaces the mesh, vertices are in chunk local voxel units.
+		Arrays are moved from.
+	*/
+	void SetMesh(TArray<FVoxelPackedVertex>& vertices, TArray<uint32>& indices);
+
+	// Bytes of vertex and index data sent to the GPU
+	UFUNCTION(BlueprintCallable)
+	int32 GetVertexBufferSize() const {
+		return m_vertices.Num() * sizeof(FVoxelPackedVertex);
+	}
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetIndexBufferSize() const {
+		return m_indices.Num() * sizeof(uint32);
+	}
+
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	virtual int32 GetNumMaterials() const override;
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+private:
+	friend class FVoxelChunkSceneProxy;
+
+	TArray<FVoxelPackedVertex> m_vertices;
+	TArray<uint32> m_indices;
+	FBox m_localBounds;
+};
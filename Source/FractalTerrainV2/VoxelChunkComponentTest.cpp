@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelChunkComponent.h"
+
+#include "Misc/AutomationTest.h"
+#include "ProceduralMeshComponent.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/*
+	Packed chunk buffers against the procedural mesh section of the same
+	faces. Needs no rendering, runs with -nullrhi.
+*/
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVoxelChunkBufferSizeTest, "FractalTerrain.Terrain.PackedBufferSize",
+	EAutomationTestFlags::EngineFilter | EAutomationTestFlags::ApplicationContextMask)
+
+bool FVoxelChunkBufferSizeTest::RunTest(const FString& Parameters) {
+	// Top faces of a 4x4 voxel floor, same corners and winding as the terrain
+	const int32 size = 4;
+	TArray<FVoxelPackedVertex> packedVertices;
+	TArray<uint32> indices;
+	TArray<FVector> vertices;
+	TArray<int32> triangles;
+	for (int32 y = 0; y < size; ++y) {
+		for (int32 x = 0; x < size; ++x) {
+			const int32 first = packedVertices.Num();
+			for (int32 i = 0; i < 4; ++i) {
+				const int32 cx = x + (i >> 1);
+				const int32 cy = y + (i & 1);
+				packedVertices.Add(PackVoxelVertex(cx, cy, 1, 5, 0));
+				vertices.Emplace(cx, cy, 1);
+			}
+			const int32 faceIndices[6] = { 1, 3, 2, 1, 2, 0 };
+			for (int32 i = 0; i < 6; ++i) {
+				indices.Add(first + faceIndices[i]);
+				triangles.Add(first + faceIndices[i]);
+			}
+		}
+	}
+	const int32 vertexCount = vertices.Num();
+	const int32 indexCount = triangles.Num();
+
+	UVoxelChunkComponent* packed = NewObject<UVoxelChunkComponent>();
+	packed->SetMesh(packedVertices, indices);
+	TestEqual(TEXT("Packed vertex buffer size"), packed->GetVertexBufferSize(), vertexCount * 4);
+	TestEqual(TEXT("Packed index buffer size"), packed->GetIndexBufferSize(), indexCount * 4);
+
+	UProceduralMeshComponent* mesh = NewObject<UProceduralMeshComponent>();
+	mesh->CreateMeshSection_LinearColor(0, vertices, triangles, TArray<FVector>(), TArray<FVector2D>(),
+		TArray<FLinearColor>(), TArray<FProcMeshTangent>(), false);
+	const FProcMeshSection* section = mesh->GetProcMeshSection(0);
+	if (!TestNotNull(TEXT("Procedural section"), section))
+		return false;
+
+	const int32 proceduralSize = section->ProcVertexBuffer.Num() * sizeof(FProcMeshVertex);
+	TestTrue(FString::Printf(TEXT("Packed vertices (%d bytes) at least 6 times smaller than procedural ones (%d bytes)"),
+		packed->GetVertexBufferSize(), proceduralSize),
+		packed->GetVertexBufferSize() * 6 <= proceduralSize);
+	return true;
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelChunkVertexFactory.h"
+
+#include "MaterialShared.h"
+#include "ShaderParameterUtils.h"
+
+void FVoxelChunkVertexBuffer::InitRHI() {
+	const uint32 size = Vertices.Num() * sizeof(FVoxelPackedVertex);
+	if (size == 0)
+		return;
+
+	FRHIResourceCreateInfo createInfo;
+	VertexBufferRHI = RHICreateVertexBuffer(size, BUF_Static, createInfo);
+	void* data = RHILockVertexBuffer(VertexBufferRHI, 0, size, RLM_WriteOnly);
+	FMemory::Memcpy(data, Vertices.GetData(), size);
+	RHIUnlockVertexBuffer(VertexBufferRHI);
+}
+
+void FVoxelChunkIndexBuffer::InitRHI() {
+	const uint32 size = Indices.Num() * sizeof(uint32);
+	if (size == 0)
+		return;
+
+	FRHIResourceCreateInfo createInfo;
+	IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint32), size, BUF_Static, createInfo);
+	void* data = RHILockIndexBuffer(IndexBufferRHI, 0, size, RLM_WriteOnly);
+	FMemory::Memcpy(data, Indices.GetData(), size);
+	RHIUnlockIndexBuffer(IndexBufferRHI);
+}
+
+FVoxelChunkVertexFactory::FVoxelChunkVertexFactory(ERHIFeatureLevel::Type featureLevel) :
+	FVertexFactory(featureLevel),
+	m_vertexBuffer(nullptr)
+{
+}
+
+bool FVoxelChunkVertexFactory::ShouldCompilePermutation(EShaderPlatform Platform, const FMaterial* Material, const FShaderType* ShaderType) {
+	// Only surface materials placed on terrain, without tessellation
+	return (Material->IsUsedWithProceduralMeshComponent() || Material->IsSpecialEngineMaterial())
+		&& Material->GetTessellationMode() == MTM_NoTessellation;
+}
+
+void FVoxelChunkVertexFactory::ModifyCompilationEnvironment(const FVertexFactoryType* Type, EShaderPlatform Platform, const FMaterial* Material, FShaderCompilerEnvironment& OutEnvironment) {
+	OutEnvironment.SetDefine(TEXT("VOXEL_PACKED_MAX_COORD"), VoxelPackedMaxCoord);
+}
+
+void FVoxelChunkVertexFactory::InitRHI() {
+	check(m_vertexBuffer);
+
+	FVertexDeclarationElementList elements;
+	elements.Add(AccessStreamComponent(FVertexStreamComponent(m_vertexBuffer, 0, sizeof(FVoxelPackedVertex), VET_UInt), 0));
+	InitDeclaration(elements);
+}
+
+IMPLEMENT_VERTEX_FACTORY_TYPE(FVoxelChunkVertexFactory, "/Project/Private/VoxelChunkVertexFactory.ush", true, false, true, false, false);
@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderResource.h"
+#include "VertexFactory.h"
+
+/*
+	Chunk vertex packed into 32 bits:
+	bits 0-17 chunk local position (6 bits per axis),
+	bits 18-20 face direction (same order as the chunk neighbours),
+	bits 21-28 material index (block type - 2).
+	Normals and tangents are derived from the face in the vertex shader.
+*/
+typedef uint32 FVoxelPackedVertex;
+
+static_assert(sizeof(FVoxelPackedVertex) == 4, "Packed voxel vertex must fit in 32 bits");
+
+// Largest local coordinate a packed vertex holds, chunks must not be bigger
+static const int32 VoxelPackedMaxCoord = 63;
+
+inline FVoxelPackedVertex PackVoxelVertex(int32 x, int32 y, int32 z, int32 face, int32 material) {
+	return (x & 63) | ((y & 63) << 6) | ((z & 63) << 12) | ((face & 7) << 18) | ((material & 255) << 21);
+}
+
+class FVoxelChunkVertexBuffer : public FVertexBuffer {
+public:
+	TArray<FVoxelPackedVertex> Vertices;
+
+	virtual void InitRHI() override;
+};
+
+class FVoxelChunkIndexBuffer : public FIndexBuffer {
+public:
+	TArray<uint32> Indices;
+
+	virtual void InitRHI() override;
+};
+
+/*
+	Reads the single packed vertex stream, see VoxelChunkVertexFactory.ush.
+*/
+class FVoxelChunkVertexFactory : public FVertexFactory {
+	DECLARE_VERTEX_FACTORY_TYPE(FVoxelChunkVertexFactory);
+
+public:
+	FVoxelChunkVertexFactory(ERHIFeatureLevel::Type featureLevel);
+
+	static bool ShouldCompilePermutation(EShaderPlatform Platform, const class FMaterial* Material, const class FShaderType* ShaderType);
+	static void ModifyCompilationEnvironment(const FVertexFactoryType* Type, EShaderPlatform Platform, const class FMaterial* Material, FShaderCompilerEnvironment& OutEnvironment);
+
+	// No parameters besides the primitive uniform buffer
+	static FVertexFactoryShaderParameters* ConstructShaderParameters(EShaderFrequency ShaderFrequency) {
+		return nullptr;
+	}
+
+	void SetVertexBuffer(const FVoxelChunkVertexBuffer* buffer) {
+		m_vertexBuffer = buffer;
+	}
+
+	virtual void InitRHI() override;
+
+private:
+	const FVoxelChunkVertexBuffer* m_vertexBuffer;
+};
@@ -0,0 +1,189 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelMovementComponent.h"
+#include "Terrain.h"
+
+#include "GameFramework/Character.h"
+#include "GameFramework/PhysicsVolume.h"
+#include "Components/CapsuleComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+#include "CollisionQueryParams.h"
+
+// Gap kept between the character box and voxel faces
+static const float VoxelSkin = 0.5f;
+
+UVoxelMovementComponent::UVoxelMovementComponent() :
+	bUseVoxelMovement(true),
+	m_terrain(nullptr)
+{
+	DefaultLandMovementMode = MOVE_Custom;
+}
+
+void UVoxelMovementComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TArray<AActor*> actors;
+	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ATerrain::StaticClass(), actors);
+	if (bUseVoxelMovement && actors.Num() == 1)
+		m_terrain = static_cast<ATerrain*>(actors[0]);
+
+	if (!m_terrain) {
+		if (bUseVoxelMovement)
+			UE_LOG(LogTemp, Warning, TEXT("No terrain for voxel movement, using default movement."));
+		DefaultLandMovementMode = MOVE_Walking;
+		SetDefaultMovementMode();
+		return;
+	}
+
+	SetMovementMode(MOVE_Custom, VOXEL_FALLING);
+}
+
+bool UVoxelMovementComponent::IsMovingOnGround() const {
+	return Super::IsMovingOnGround() || (isVoxelMode() && CustomMovementMode == VOXEL_WALKING);
+}
+
+bool UVoxelMovementComponent::IsFalling() const {
+	return Super::IsFalling() || (isVoxelMode() && CustomMovementMode == VOXEL_FALLING);
+}
+
+float UVoxelMovementComponent::GetMaxSpeed() const {
+	if (!isVoxelMode())
+		return Super::GetMaxSpeed();
+	return IsCrouching() ? MaxWalkSpeedCrouched : MaxWalkSpeed;
+}
+
+float UVoxelMovementComponent::GetMaxBrakingDeceleration() const {
+	if (!isVoxelMode())
+		return Super::GetMaxBrakingDeceleration();
+	return CustomMovementMode == VOXEL_WALKING ? BrakingDecelerationWalking : BrakingDecelerationFalling;
+}
+
+bool UVoxelMovementComponent::DoJump(bool bReplayingMoves) {
+	if (!isVoxelMode())
+		return Super::DoJump(bReplayingMoves);
+
+	if (CharacterOwner && CharacterOwner->CanJump()) {
+		Velocity.Z = FMath::Max(Velocity.Z, JumpZVelocity);
+		SetMovementMode(MOVE_Custom, VOXEL_FALLING);
+		return true;
+	}
+	return false;
+}
+
+void UVoxelMovementComponent::PhysCustom(float deltaTime, int32 Iterations) {
+	if (!isVoxelMode()) {
+		Super::PhysCustom(deltaTime, Iterations);
+		return;
+	}
+	if (deltaTime < MIN_TICK_TIME)
+		return;
+
+	const FVector location = UpdatedComponent->GetComponentLocation();
+	float radius, halfHeight;
+	CharacterOwner->GetCapsuleComponent()->GetScaledCapsuleSize(radius, halfHeight);
+	const FVector extent(radius, radius, halfHeight);
+	FBox box(location - extent, location + extent);
+
+	const bool walking = CustomMovementMode == VOXEL_WALKING;
+
+	// Input drives horizontal velocity, gravity the vertical one
+	const float verticalSpeed = Velocity.Z;
+	Velocity.Z = 0.f;
+	if (!HasAnimRootMotion())
+		CalcVelocity(deltaTime, walking ? GroundFriction : FallingLateralFriction, false, GetMaxBrakingDeceleration());
+	Velocity.Z = walking ? 0.f : verticalSpeed + GetGravityZ() * deltaTime;
+	Velocity.Z = FMath::Max(Velocity.Z, -GetPhysicsVolume()->TerminalVelocity);
+
+	const FVector delta = Velocity * deltaTime;
+
+	// Hold still until the voxels along the whole move exist, steps up and
+	// ground checks included
+	if (!m_terrain->IsGenerated((box + box.ShiftBy(delta)).ExpandBy(FVector(0.f, 0.f, m_terrain->VoxelSize)))) {
+		Velocity = FVector::ZeroVector;
+		return;
+	}
+
+	// Resolve each axis separately, horizontal first so ledges can be stepped on
+	if (!moveAxis(box, 0, delta.X, walking))
+		Velocity.X = 0.f;
+	if (!moveAxis(box, 1, delta.Y, walking))
+		Velocity.Y = 0.f;
+
+	bool grounded;
+	if (walking) {
+		grounded = blockedByGrid(box.ShiftBy(FVector(0.f, 0.f, -2.f * VoxelSkin)));
+	} else {
+		const bool blocked = !moveAxis(box, 2, delta.Z, false);
+		grounded = blocked && delta.Z < 0.f;
+		if (blocked)
+			Velocity.Z = 0.f;
+	}
+
+	MoveUpdatedComponent(box.GetCenter() - location, UpdatedComponent->GetComponentQuat(), false);
+
+	// Mode changes let the character reset its jump state on landing
+	if (walking && !grounded)
+		SetMovementMode(MOVE_Custom, VOXEL_FALLING);
+	else if (!walking && grounded)
+		SetMovementMode(MOVE_Custom, VOXEL_WALKING);
+}
+
+bool UVoxelMovementComponent::blockedByGrid(const FBox& box) const {
+	return m_terrain->OverlapsSolid(box) || m_terrain->OverlapsOccupied(box);
+}
+
+bool UVoxelMovementComponent::blockedByPawn(const FBox& box) const {
+	FCollisionQueryParams params(SCENE_QUERY_STAT(VoxelMovementPawns), false, CharacterOwner);
+	return GetWorld()->OverlapAnyTestByObjectType(box.GetCenter(), FQuat::Identity,
+		FCollisionObjectQueryParams(ECC_Pawn), FCollisionShape::MakeBox(box.GetExtent()), params);
+}
+
+bool UVoxelMovementComponent::moveAxis(FBox& box, int32 axis, float delta, bool canStepUp) const {
+	if (delta == 0.f)
+		return true;
+
+	// Steps smaller than half a voxel cannot tunnel through one
+	const float voxelSize = m_terrain->VoxelSize;
+	const int32 steps = FMath::Max(1, FMath::CeilToInt(FMath::Abs(delta) / (voxelSize * 0.45f)));
+	const float step = delta / steps;
+
+	for (int32 i = 0; i < steps; ++i) {
+		FVector offset(0.f);
+		offset[axis] = step;
+		const FBox moved = box.ShiftBy(offset);
+		const bool gridBlocked = blockedByGrid(moved);
+		if (!gridBlocked && !blockedByPawn(moved)) {
+			box = moved;
+			continue;
+		}
+
+		if (canStepUp && gridBlocked) {
+			// Lift feet on top of the voxel layer they stand in
+			const FVector up(0.f, 0.f, (FMath::FloorToFloat(box.Min.Z / voxelSize) + 1.f) * voxelSize + VoxelSkin - box.Min.Z);
+			const FBox lifted = moved.ShiftBy(up);
+			if (!blockedByGrid(box.ShiftBy(up)) && !blockedByGrid(lifted) && !blockedByPawn(lifted)) {
+				box = lifted;
+				continue;
+			}
+		}
+
+		// Pawns are not on the grid, stop where we are
+		if (!gridBlocked)
+			return false;
+
+		// Blocked, rest against the face of the voxel we ran into
+		if (step > 0.f) {
+			const float face = FMath::FloorToFloat(moved.Max[axis] / voxelSize) * voxelSize - VoxelSkin;
+			offset[axis] = FMath::Max(0.f, face - box.Max[axis]);
+		} else {
+			const float face = (FMath::FloorToFloat(moved.Min[axis] / voxelSize) + 1.f) * voxelSize + VoxelSkin;
+			offset[axis] = FMath::Min(0.f, face - box.Min[axis]);
+		}
+		box = box.ShiftBy(offset);
+		return false;
+	}
+	return true;
+}
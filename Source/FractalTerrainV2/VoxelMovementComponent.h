@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "VoxelMovementComponent.generated.h"
+
+class ATerrain;
+
+/**
+	Character movement resolved directly against the terrain voxels, instead
+	of sweeping the capsule against cooked chunk collision.
+	Runs as MOVE_Custom, with walking and falling as custom sub modes.
+ */
+UCLASS()
+class FRACTALTERRAINV2_API UVoxelMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	enum VoxelMovementMode {
+		VOXEL_WALKING = 0,
+		VOXEL_FALLING = 1
+	};
+
+	UVoxelMovementComponent();
+
+	virtual void BeginPlay() override;
+
+	virtual bool IsMovingOnGround() const override;
+	virtual bool IsFalling() const override;
+	virtual float GetMaxSpeed() const override;
+	virtual float GetMaxBrakingDeceleration() const override;
+	virtual bool DoJump(bool bReplayingMoves) override;
+
+	// Falls back to stock movement when no terrain is found
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Voxel Movement")
+	bool bUseVoxelMovement;
+
+protected:
+	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+
+	bool isVoxelMode() const {
+		return MovementMode == MOVE_Custom && m_terrain != nullptr;
+	}
+
+	// Solid voxels and cells held by placed machines
+	bool blockedByGrid(const FBox& box) const;
+	// Other pawns, which live off the grid
+	bool blockedByPawn(const FBox& box) const;
+
+	/*
+		Moves box along one axis, stopping at the first solid voxel, machine
+		or pawn.
+		Horizontal moves step up one block ledges when walking.
+		Returns false if the move was blocked.
+	*/
+	bool moveAxis(FBox& box, int32 axis, float delta, bool canStepUp) const;
+
+	ATerrain* m_terrain;
+};